@@ -0,0 +1,341 @@
+// Benchmark de overhead de las pintools.
+//
+// Corre cada workload de cases.txt nativo y bajo cada modo de herramienta,
+// mide tiempo de pared (mediana de --reps), slowdown respecto del nativo y
+// RSS pico, y escribe un CSV. Con --baseline compara el slowdown de cada
+// par (workload, modo) contra el guardado y termina con código 1 si alguno
+// empeora más que --threshold, si el baseline no se puede leer o si un par
+// medido no está en él (hay que regenerarlo con --update-baseline 1).
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+using std::string;
+using std::vector;
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+struct Workload {
+    string name;
+    vector<string> command;
+};
+
+struct ToolMode {
+    string name;
+    string tool;
+    vector<string> args;
+};
+
+struct BenchConfig {
+    string cases = "cases.txt";
+    string output = "bench_results.csv";
+    string baseline;
+    string pin;
+    string toolDir = "../profiler/obj-intel64";
+    string workDir = "bench_tmp";
+    unsigned reps = 3;
+    double threshold = 0.10;
+    bool updateBaseline = false;
+};
+
+struct Measurement {
+    string workload;
+    string mode;
+    double seconds = 0;
+    double slowdown = 1.0;
+    long maxRssKb = 0;
+    bool failed = false;
+};
+
+// ============================================================================
+// EJECUCIÓN
+// ============================================================================
+
+double NowSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+vector<string> SplitWords(const string& line) {
+    std::istringstream ss(line);
+    vector<string> words;
+    string w;
+    while (ss >> w) {
+        words.push_back(w);
+    }
+    return words;
+}
+
+// Ejecutar argv (salida descartada); tiempo de pared y RSS pico (wait4)
+bool RunOnce(const vector<string>& argv, double& seconds, long& maxRssKb) {
+    double start = NowSeconds();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDOUT_FILENO);
+            dup2(devnull, STDERR_FILENO);
+            close(devnull);
+        }
+        vector<char*> args;
+        for (const string& a : argv) {
+            args.push_back(const_cast<char*>(a.c_str()));
+        }
+        args.push_back(nullptr);
+        execvp(args[0], args.data());
+        _exit(127);
+    }
+    if (pid < 0) {
+        return false;
+    }
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        return false;
+    }
+    seconds = NowSeconds() - start;
+    maxRssKb = usage.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Mediana de reps corridas; RSS pico máximo entre ellas
+Measurement Measure(const vector<string>& argv, unsigned reps) {
+    Measurement m;
+    vector<double> times;
+    for (unsigned r = 0; r < reps; r++) {
+        double seconds = 0;
+        long rss = 0;
+        if (!RunOnce(argv, seconds, rss)) {
+            m.failed = true;
+            return m;
+        }
+        times.push_back(seconds);
+        m.maxRssKb = std::max(m.maxRssKb, rss);
+    }
+    std::sort(times.begin(), times.end());
+    m.seconds = times[times.size() / 2];
+    return m;
+}
+
+// ============================================================================
+// CASOS Y BASELINE
+// ============================================================================
+
+// cases.txt:
+//   workload <nombre> <comando...>
+//   mode <nombre> <herramienta> <args...>
+// Líneas vacías y comentarios (#) se ignoran
+bool LoadCases(const string& path, vector<Workload>& workloads, vector<ToolMode>& modes) {
+    std::ifstream in(path.c_str());
+    if (!in.is_open()) {
+        return false;
+    }
+    string line;
+    while (std::getline(in, line)) {
+        vector<string> words = SplitWords(line);
+        if (words.empty() || words[0][0] == '#') {
+            continue;
+        }
+        if (words[0] == "workload" && words.size() >= 3) {
+            workloads.push_back({words[1], vector<string>(words.begin() + 2, words.end())});
+        } else if (words[0] == "mode" && words.size() >= 3) {
+            modes.push_back({words[1], words[2], vector<string>(words.begin() + 3, words.end())});
+        } else {
+            std::cerr << "ERROR: línea inválida en " << path << ": " << line << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Baseline: mismo CSV que la salida, indexado por "workload/modo". False si
+// el archivo no existe o no tiene cabecera
+bool LoadBaseline(const string& path, std::map<string, double>& slowdowns) {
+    std::ifstream in(path.c_str());
+    string line;
+    if (!std::getline(in, line)) {   // cabecera
+        return false;
+    }
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        string workload, mode, seconds, slowdown;
+        if (std::getline(ss, workload, ',') && std::getline(ss, mode, ',') &&
+            std::getline(ss, seconds, ',') && std::getline(ss, slowdown, ',')) {
+            slowdowns[workload + "/" + mode] = std::stod(slowdown);
+        }
+    }
+    return true;
+}
+
+bool WriteResults(const string& path, const vector<Measurement>& results) {
+    std::ofstream out(path.c_str());
+    if (!out.is_open()) {
+        return false;
+    }
+    out << "workload,mode,seconds,slowdown,max_rss_kb" << std::endl;
+    for (const Measurement& m : results) {
+        if (m.failed) {
+            continue;
+        }
+        out << m.workload << "," << m.mode << "," << m.seconds << ","
+            << m.slowdown << "," << m.maxRssKb << std::endl;
+    }
+    return true;
+}
+
+int Usage() {
+    std::cerr << "Uso: bench_overhead [opciones]" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  --cases <file>       Workloads y modos (default: cases.txt)" << std::endl;
+    std::cerr << "  --output <file>      Resultados CSV (default: bench_results.csv)" << std::endl;
+    std::cerr << "  --baseline <file>    Comparar slowdowns contra este CSV" << std::endl;
+    std::cerr << "  --threshold <f>      Regresión tolerada, fracción (default: 0.10)" << std::endl;
+    std::cerr << "  --update-baseline 1  Reescribir --baseline con esta corrida" << std::endl;
+    std::cerr << "  --reps <n>           Repeticiones por caso, se usa la mediana (default: 3)" << std::endl;
+    std::cerr << "  --pin <path>         Ejecutable de Pin (default: $PIN_ROOT/pin)" << std::endl;
+    std::cerr << "  --tool-dir <dir>     Directorio de las .so (default: ../profiler/obj-intel64)" << std::endl;
+    std::cerr << "  --workdir <dir>      Salidas de las herramientas (default: bench_tmp)" << std::endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig cfg;
+    const char* pinRoot = std::getenv("PIN_ROOT");
+    cfg.pin = pinRoot ? string(pinRoot) + "/pin" : "../../pin/pin";
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            return Usage();
+        }
+        string value = argv[++i];
+        if (arg == "--cases") {
+            cfg.cases = value;
+        } else if (arg == "--output") {
+            cfg.output = value;
+        } else if (arg == "--baseline") {
+            cfg.baseline = value;
+        } else if (arg == "--threshold") {
+            cfg.threshold = std::stod(value);
+        } else if (arg == "--update-baseline") {
+            cfg.updateBaseline = value == "1";
+        } else if (arg == "--reps") {
+            cfg.reps = std::max(1, std::stoi(value));
+        } else if (arg == "--pin") {
+            cfg.pin = value;
+        } else if (arg == "--tool-dir") {
+            cfg.toolDir = value;
+        } else if (arg == "--workdir") {
+            cfg.workDir = value;
+        } else {
+            return Usage();
+        }
+    }
+
+    vector<Workload> workloads;
+    vector<ToolMode> modes;
+    if (!LoadCases(cfg.cases, workloads, modes)) {
+        std::cerr << "ERROR: No se pudo leer " << cfg.cases << std::endl;
+        return 1;
+    }
+    mkdir(cfg.workDir.c_str(), 0755);
+
+    vector<Measurement> results;
+    for (const Workload& w : workloads) {
+        // Workloads opcionales (ej: sin OpenFHE compilado) se saltean
+        if (access(w.command[0].c_str(), X_OK) != 0) {
+            std::cerr << "[SKIP] " << w.name << ": " << w.command[0] << " no existe" << std::endl;
+            continue;
+        }
+
+        Measurement native = Measure(w.command, cfg.reps);
+        native.workload = w.name;
+        native.mode = "native";
+        if (native.failed) {
+            std::cerr << "[FAIL] " << w.name << " nativo" << std::endl;
+            continue;
+        }
+        results.push_back(native);
+        std::cerr << "[INFO] " << w.name << " nativo: " << native.seconds << "s" << std::endl;
+
+        for (const ToolMode& mode : modes) {
+            string outPath = cfg.workDir + "/" + w.name + "." + mode.name + ".out";
+            vector<string> argv = {cfg.pin, "-t", cfg.toolDir + "/" + mode.tool + ".so",
+                                   "-o", outPath};
+            argv.insert(argv.end(), mode.args.begin(), mode.args.end());
+            argv.push_back("--");
+            argv.insert(argv.end(), w.command.begin(), w.command.end());
+
+            Measurement m = Measure(argv, cfg.reps);
+            m.workload = w.name;
+            m.mode = mode.name;
+            if (m.failed) {
+                std::cerr << "[FAIL] " << w.name << " / " << mode.name << std::endl;
+                results.push_back(m);
+                continue;
+            }
+            m.slowdown = m.seconds / std::max(native.seconds, 1e-6);
+            results.push_back(m);
+            std::cerr << "[INFO] " << w.name << " / " << mode.name << ": "
+                      << m.seconds << "s, " << m.slowdown << "x, "
+                      << m.maxRssKb << " KB" << std::endl;
+        }
+    }
+
+    if (!WriteResults(cfg.output, results)) {
+        std::cerr << "ERROR: No se pudo escribir " << cfg.output << std::endl;
+        return 1;
+    }
+
+    bool regression = false;
+    for (const Measurement& m : results) {
+        regression |= m.failed;
+    }
+
+    if (!cfg.baseline.empty() && cfg.updateBaseline) {
+        WriteResults(cfg.baseline, results);
+        std::cerr << "[INFO] Baseline actualizado: " << cfg.baseline << std::endl;
+    } else if (!cfg.baseline.empty()) {
+        std::map<string, double> baseline;
+        if (!LoadBaseline(cfg.baseline, baseline)) {
+            std::cerr << "ERROR: No se pudo leer el baseline " << cfg.baseline
+                      << " (generarlo con --update-baseline 1)" << std::endl;
+            return 1;
+        }
+        for (const Measurement& m : results) {
+            if (m.failed || m.mode == "native") {
+                continue;
+            }
+            // Un par sin baseline no se puede validar: también falla
+            auto it = baseline.find(m.workload + "/" + m.mode);
+            if (it == baseline.end()) {
+                std::cerr << "[SIN BASELINE] " << m.workload << " / " << m.mode << std::endl;
+                regression = true;
+                continue;
+            }
+            double limit = it->second * (1.0 + cfg.threshold);
+            if (m.slowdown > limit) {
+                std::cerr << "[REGRESIÓN] " << m.workload << " / " << m.mode << ": "
+                          << m.slowdown << "x (baseline " << it->second << "x)" << std::endl;
+                regression = true;
+            }
+        }
+    }
+
+    return regression ? 1 : 0;
+}
@@ -0,0 +1,740 @@
+// Orquestador de campañas de inyección de fallas.
+//
+// Mantiene un pool de procesos Pin (uno por core por defecto). Cada worker
+// toma la próxima falla pendiente de un contador compartido, así ningún core
+// queda ocioso mientras haya fallas. Cada resultado se agrega como una línea
+// al archivo de resultados; al relanzar la campaña con el mismo archivo se
+// saltean las fallas ya terminadas.
+//
+// Con --checkpoint las fallas van por lotes a un fork-server del inyector:
+// un solo proceso Pin corre el programa hasta el checkpoint y crea un hijo
+// por falla, --jobs a la vez, así el setup (contexto, claves, encoding) se
+// paga una vez por lote y no una vez por falla.
+
+#include "alias_sampler.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+using std::string;
+using std::vector;
+
+// ============================================================================
+// CONFIGURACIÓN
+// ============================================================================
+
+struct CampaignConfig {
+    string pin;
+    string tool;
+    string binary;
+    vector<string> binaryArgs;
+    vector<string> functions;
+    vector<string> opcodes;
+    string profile;
+    string target = "reg";
+    string checkpoint;          // --checkpoint: rutina del fork-server
+    string results = "campaign_results.log";
+    string workDir = "campaign_tmp";
+    uint64_t numFaults = 0;
+    uint64_t seed = 1;
+    unsigned jobs = 0;
+    double timeoutFactor = 10.0;
+    double budgetFactor = 2.0;  // 0: sin presupuesto (los hangs solo por timeout)
+    bool catchSignals = true;   // crashes registrados por el inyector
+    uint64_t budget = 0;        // instrucciones tras la inyección (de la corrida dorada)
+};
+
+// Falla a inyectar: instancia dinámica y bit (el inyector aplica el módulo
+// del ancho del registro; 512 es múltiplo de todos los anchos)
+struct Fault {
+    uint64_t id;
+    uint64_t instance;
+    uint32_t bit;
+    int64_t record = -1;    // --profile: registro del perfil por IP sorteado
+};
+
+const uint32_t MAX_REGISTER_BITS = 512;
+
+enum Outcome {
+    OUTCOME_MASKED,
+    OUTCOME_SDC,
+    OUTCOME_CRASH,
+    OUTCOME_HANG,
+    OUTCOME_NOT_INJECTED,
+    OUTCOME_NUM
+};
+
+const char* OutcomeNames[] = {
+    "masked", "sdc", "crash", "hang", "not_injected"
+};
+
+// Resultado de una corrida de Pin
+struct RunResult {
+    bool timedOut = false;
+    bool signaled = false;
+    int code = 0;
+    double seconds = 0.0;
+    bool lost = false;          // fork-server: el hijo no llegó a registrar su fin
+    string stdoutText;
+    string injectionLog;
+};
+
+// Fallas por proceso del fork-server y por job: cada lote paga el setup una
+// vez y deja sus resultados escritos antes del siguiente
+const uint64_t FORK_BATCH_PER_JOB = 32;
+
+// ============================================================================
+// PROCESOS
+// ============================================================================
+
+double NowSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+string ReadFile(const string& path) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// Ejecutar argv con stdout redirigido a stdoutPath. Si timeout > 0 y se
+// excede, se mata al grupo de procesos completo (Pin y la aplicación)
+RunResult RunProcess(const vector<string>& argv, const string& stdoutPath, double timeout) {
+    RunResult result;
+    double start = NowSeconds();
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        setpgid(0, 0);
+        int fd = open(stdoutPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            close(fd);
+        }
+        vector<char*> args;
+        for (const string& a : argv) {
+            args.push_back(const_cast<char*>(a.c_str()));
+        }
+        args.push_back(nullptr);
+        execvp(args[0], args.data());
+        _exit(127);
+    }
+    if (pid < 0) {
+        result.signaled = true;
+        return result;
+    }
+
+    int status = 0;
+    while (true) {
+        pid_t r = waitpid(pid, &status, WNOHANG);
+        if (r == pid) {
+            break;
+        }
+        if (r < 0 && errno != EINTR) {
+            break;
+        }
+        if (timeout > 0 && NowSeconds() - start > timeout) {
+            kill(-pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            result.timedOut = true;
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    result.seconds = NowSeconds() - start;
+    if (WIFSIGNALED(status)) {
+        result.signaled = true;
+        result.code = WTERMSIG(status);
+    } else {
+        result.code = WEXITSTATUS(status);
+    }
+    result.stdoutText = ReadFile(stdoutPath);
+    return result;
+}
+
+// Perfil por IP (--profile) y su sampler, cargados una vez en main
+IpProfile profile;
+
+// Descartar los sitios del perfil que el inyector no puede usar con el
+// --target de la campaña (ej: destino en memoria con --target reg): se
+// sortearían y terminarían siempre como not_injected. buffer usa la
+// instrucción solo como momento, sirve cualquiera
+void KeepInjectableSites(const string& target) {
+    uint16_t needed = target == "reg" ? IP_DEST_REG : (target == "mem" ? IP_DEST_MEM : 0);
+    if (needed == 0) {
+        return;
+    }
+    vector<IpProfileRecord>& records = profile.records;
+    records.erase(std::remove_if(records.begin(), records.end(),
+                                 [needed](const IpProfileRecord& r) {
+                                     return (r.destinations & needed) == 0;
+                                 }),
+                  records.end());
+}
+
+vector<string> InjectorCommand(const CampaignConfig& cfg, const Fault& fault,
+                               const string& logPath) {
+    vector<string> argv = {cfg.pin, "-t", cfg.tool};
+    if (fault.record >= 0) {
+        const IpProfileRecord& r = profile.records[fault.record];
+        argv.insert(argv.end(), {"-ip_image", profile.images[r.image],
+                                 "-ip_offset", std::to_string(r.offset)});
+    } else {
+        for (const string& f : cfg.functions) {
+            argv.insert(argv.end(), {"-f", f});
+        }
+        for (const string& op : cfg.opcodes) {
+            argv.insert(argv.end(), {"-op", op});
+        }
+        // La corrida dorada llena el cache; las fallas arrancan sin recorrer la imagen
+        argv.insert(argv.end(), {"-decision_cache", cfg.workDir + "/decision_cache"});
+    }
+    // La corrida dorada cuenta instrucciones y las fallas las usan como
+    // presupuesto: un loop termina en outcome=hang sin esperar el timeout.
+    // Las señales fatales se registran aparte, con o sin presupuesto
+    if (fault.instance == UINT64_MAX) {
+        if (cfg.budgetFactor > 0) {
+            argv.insert(argv.end(), {"-count_ins", "1"});
+        }
+    } else {
+        if (cfg.budget > 0) {
+            argv.insert(argv.end(), {"-budget", std::to_string(cfg.budget)});
+        }
+        if (cfg.catchSignals) {
+            argv.insert(argv.end(), {"-catch_signals", "1"});
+        }
+    }
+    argv.insert(argv.end(), {"-target", cfg.target,
+                             "-n", std::to_string(fault.instance),
+                             "-bit", std::to_string(fault.bit),
+                             "-o", logPath,
+                             "--", cfg.binary});
+    argv.insert(argv.end(), cfg.binaryArgs.begin(), cfg.binaryArgs.end());
+    return argv;
+}
+
+// Fork-server: el comando de la falla modelo (dorada o no) más el
+// checkpoint, el archivo de fallas y un stdout por hijo
+vector<string> ForkServerCommand(const CampaignConfig& cfg, const Fault& model,
+                                 const string& paramsPath, const string& logPath,
+                                 const string& outPrefix, double childTimeout) {
+    vector<string> argv = InjectorCommand(cfg, model, logPath);
+    auto separator = std::find(argv.begin(), argv.end(), "--");
+    argv.insert(separator, {"-checkpoint", cfg.checkpoint,
+                            "-params", paramsPath,
+                            "-fork_jobs", std::to_string(cfg.jobs),
+                            "-fork_timeout", std::to_string(static_cast<uint64_t>(std::ceil(childTimeout))),
+                            "-fork_output", outPrefix});
+    return argv;
+}
+
+// Entero sin signo en decimal; false si el texto está vacío o no es un
+// número completo (sin excepciones: un archivo dañado no aborta la campaña)
+bool ParseUint64(const string& text, uint64_t& value) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long parsed = std::strtoull(text.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0') {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+// Índice en OutcomeNames, u OUTCOME_NUM si no es un outcome conocido
+int OutcomeFromName(const string& name) {
+    for (int o = 0; o < OUTCOME_NUM; o++) {
+        if (name == OutcomeNames[o]) {
+            return o;
+        }
+    }
+    return OUTCOME_NUM;
+}
+
+// Valor de una clave en un registro key=value del inyector
+string RecordValue(const string& record, const string& key) {
+    string needle = key + "=";
+    size_t pos = 0;
+    while ((pos = record.find(needle, pos)) != string::npos) {
+        if (pos == 0 || record[pos - 1] == ' ' || record[pos - 1] == '\n') {
+            size_t begin = pos + needle.size();
+            size_t end = record.find_first_of(" \n", begin);
+            return record.substr(begin, end == string::npos ? string::npos : end - begin);
+        }
+        pos += needle.size();
+    }
+    return "";
+}
+
+// Líneas del registro del fork-server que empiezan con "id=<id> "
+string ForkChildLog(const string& log, uint64_t id) {
+    string prefix = "id=" + std::to_string(id) + " ";
+    string lines;
+    size_t pos = 0;
+    while (pos < log.size()) {
+        size_t end = log.find('\n', pos);
+        if (end == string::npos) {
+            end = log.size();
+        }
+        if (log.compare(pos, prefix.size(), prefix) == 0) {
+            lines.append(log, pos, end - pos);
+            lines += '\n';
+        }
+        pos = end + 1;
+    }
+    return lines;
+}
+
+// Correr un lote en el fork-server. El hijo i (id i+1 en el servidor) corre
+// faults[i]; su resultado sale de sus líneas en el registro y de su stdout.
+// Sin línea end= el hijo queda lost y la falla se reintenta al retomar
+vector<RunResult> RunForkBatch(const CampaignConfig& cfg, const Fault& model,
+                               const vector<Fault>& faults, double childTimeout) {
+    string paramsPath = cfg.workDir + "/fork.params";
+    string logPath = cfg.workDir + "/fork.log";
+    string outPrefix = cfg.workDir + "/fork_";
+    {
+        std::ofstream params(paramsPath.c_str());
+        for (const Fault& f : faults) {
+            params << f.instance << " " << f.bit << "\n";
+        }
+    }
+    unlink(logPath.c_str());
+    RunProcess(ForkServerCommand(cfg, model, paramsPath, logPath, outPrefix, childTimeout),
+               cfg.workDir + "/fork_server.out", 0);
+    string log = ReadFile(logPath);
+
+    vector<RunResult> runs(faults.size());
+    for (size_t i = 0; i < faults.size(); i++) {
+        RunResult& run = runs[i];
+        run.injectionLog = ForkChildLog(log, i + 1);
+        string end = RecordValue(run.injectionLog, "end");
+        string outPath = outPrefix + std::to_string(i + 1) + ".out";
+        run.stdoutText = ReadFile(outPath);
+        unlink(outPath.c_str());
+        run.seconds = std::atof(RecordValue(run.injectionLog, "seconds").c_str());
+        if (end == "exited") {
+            run.code = std::atoi(RecordValue(run.injectionLog, "code").c_str());
+        } else if (end == "signaled") {
+            run.signaled = true;
+            run.code = std::atoi(RecordValue(run.injectionLog, "signal").c_str());
+        } else if (end == "timeout") {
+            run.timedOut = true;
+        } else {
+            run.lost = true;
+        }
+    }
+    return runs;
+}
+
+// ============================================================================
+// CAMPAÑA
+// ============================================================================
+
+// Corrida dorada: sin inyección (-n inalcanzable) para conocer la salida
+// correcta, el tiempo de referencia y cuántas instancias dinámicas hay.
+// Con --checkpoint la corre un hijo del fork-server, igual que las fallas:
+// su stdout, su tiempo y sus instancias cuentan desde el checkpoint
+bool GoldenRun(CampaignConfig& cfg, RunResult& golden, uint64_t& instances) {
+    string logPath = cfg.workDir + "/golden.log";
+    Fault none{0, UINT64_MAX, 0};
+    if (!cfg.checkpoint.empty()) {
+        golden = RunForkBatch(cfg, none, {none}, 0)[0];
+    } else {
+        golden = RunProcess(InjectorCommand(cfg, none, logPath),
+                            cfg.workDir + "/golden.out", 0);
+        golden.injectionLog = ReadFile(logPath);
+    }
+
+    if (golden.lost || golden.signaled || golden.code != 0) {
+        std::cerr << "ERROR: la corrida dorada falló (código " << golden.code << ")" << std::endl;
+        return false;
+    }
+    string executed = RecordValue(golden.injectionLog, "executed");
+    instances = executed.empty() ? 0 : std::stoull(executed);
+    if (instances == 0 && cfg.profile.empty()) {
+        std::cerr << "ERROR: ninguna instrucción seleccionada se ejecutó" << std::endl;
+        return false;
+    }
+    string total = RecordValue(golden.injectionLog, "instructions");
+    if (!total.empty() && cfg.budgetFactor > 0) {
+        cfg.budget = static_cast<uint64_t>(std::stod(total) * cfg.budgetFactor) + 1;
+    }
+    return true;
+}
+
+// Lista determinista de fallas: misma semilla e instancias, misma lista.
+// Con perfil por IP, (IP, instancia) se sortean con el método de alias en
+// proporción a las ejecuciones de cada IP
+vector<Fault> GenerateFaults(uint64_t numFaults, uint64_t instances, uint64_t seed) {
+    if (!profile.records.empty()) {
+        AliasSampler sampler = BuildSiteSampler(profile);
+        SplitMix64 rng(seed);
+        vector<Fault> faults(numFaults);
+        for (uint64_t i = 0; i < numFaults; i++) {
+            SampledSite site = SampleSite(sampler, profile, rng);
+            faults[i].id = i;
+            faults[i].record = static_cast<int64_t>(site.record);
+            faults[i].instance = site.instance;
+            faults[i].bit = static_cast<uint32_t>(rng.Below(MAX_REGISTER_BITS));
+        }
+        return faults;
+    }
+
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<uint64_t> instanceDist(1, instances);
+    std::uniform_int_distribution<uint32_t> bitDist(0, MAX_REGISTER_BITS - 1);
+
+    vector<Fault> faults(numFaults);
+    for (uint64_t i = 0; i < numFaults; i++) {
+        faults[i].id = i;
+        faults[i].instance = instanceDist(rng);
+        faults[i].bit = bitDist(rng);
+    }
+    return faults;
+}
+
+// Leer un archivo de resultados previo: cabecera y fallas terminadas
+bool LoadPreviousResults(const string& path, uint64_t& instances, uint64_t& seed,
+                         std::set<uint64_t>& done, vector<uint64_t>& outcomeCounts) {
+    std::ifstream in(path.c_str());
+    if (!in.is_open()) {
+        return false;
+    }
+    bool headerFound = false;
+    string line;
+    while (std::getline(in, line)) {
+        if (line.rfind("# campaign ", 0) == 0) {
+            headerFound = ParseUint64(RecordValue(line, "instances"), instances) &&
+                          ParseUint64(RecordValue(line, "seed"), seed);
+            if (!headerFound) {
+                std::cerr << "AVISO: cabecera de campaña ilegible en " << path << std::endl;
+            }
+            continue;
+        }
+        // Una línea truncada por una interrupción (o pegada a la siguiente
+        // corrida) no cuenta como terminada: el outcome tiene que ser válido
+        uint64_t id;
+        int outcome = OutcomeFromName(RecordValue(line, "outcome"));
+        if (!ParseUint64(RecordValue(line, "id"), id) || outcome == OUTCOME_NUM) {
+            continue;
+        }
+        if (done.insert(id).second) {
+            outcomeCounts[outcome]++;
+        }
+    }
+    return headerFound;
+}
+
+// ¿Termina el archivo en '\n'? Una corrida interrumpida puede dejar la
+// última línea a medias; lo que se agregue tiene que empezar en otra línea
+bool EndsWithNewline(const string& path) {
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!in.is_open() || in.tellg() <= 0) {
+        return true;
+    }
+    in.seekg(-1, std::ios::end);
+    return in.get() == '\n';
+}
+
+Outcome Classify(const RunResult& run, const RunResult& golden) {
+    if (RecordValue(run.injectionLog, "status") != "injected") {
+        return OUTCOME_NOT_INJECTED;
+    }
+    // Registro del watchdog del inyector: sale apenas se agota el presupuesto
+    // o llega una señal fatal, sin esperar el timeout
+    string outcome = RecordValue(run.injectionLog, "outcome");
+    if (run.timedOut || outcome == "hang") {
+        return OUTCOME_HANG;
+    }
+    if (outcome == "crash") {
+        return OUTCOME_CRASH;
+    }
+    if (run.signaled || run.code != 0) {
+        return OUTCOME_CRASH;
+    }
+    return run.stdoutText == golden.stdoutText ? OUTCOME_MASKED : OUTCOME_SDC;
+}
+
+// Línea del registro de inyección (sin el salto final)
+string InjectionRecord(const string& log) {
+    size_t pos = log.find("status=injected");
+    if (pos == string::npos) {
+        return "";
+    }
+    size_t end = log.find('\n', pos);
+    return log.substr(pos, end == string::npos ? string::npos : end - pos);
+}
+
+int Usage() {
+    std::cerr << "Uso: run_campaign --binary <programa> --num-faults <n> [opciones] [-- args]" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  --binary <path>      Programa a inyectar" << std::endl;
+    std::cerr << "  --num-faults <n>     Fallas de la campaña" << std::endl;
+    std::cerr << "  --function <f>       Filtro -f del inyector (repetible)" << std::endl;
+    std::cerr << "  --opcode <op>        Filtro -op del inyector (repetible)" << std::endl;
+    std::cerr << "  --target <t>         Destino de la falla: reg, mem o buffer (default: reg)" << std::endl;
+    std::cerr << "  --profile <file>     Sitios ponderados por un perfil -ip_profile (ignora -f/-op)" << std::endl;
+    std::cerr << "  --checkpoint <rutina> Fork-server: setup una vez por lote, un hijo por falla" << std::endl;
+    std::cerr << "                       desde la rutina (-n cuenta desde ahí; sin --profile)" << std::endl;
+    std::cerr << "  --jobs <n>           Procesos Pin (o hijos del fork-server) simultáneos (default: cores)" << std::endl;
+    std::cerr << "  --results <file>     Resultados, append-only (default: campaign_results.log)" << std::endl;
+    std::cerr << "  --seed <s>           Semilla de la lista de fallas (default: 1)" << std::endl;
+    std::cerr << "  --timeout-factor <k> Hang si tarda más de k veces la corrida dorada (default: 10)" << std::endl;
+    std::cerr << "  --budget-factor <k>  Hang si tras inyectar ejecuta más de k veces las instrucciones" << std::endl;
+    std::cerr << "                       de la corrida dorada (default: 2; 0 lo desactiva)" << std::endl;
+    std::cerr << "  --catch-signals 0/1  El inyector registra los crashes por señal (default: 1)" << std::endl;
+    std::cerr << "  --workdir <dir>      Archivos temporales (default: campaign_tmp)" << std::endl;
+    std::cerr << "  --pin <path>         Ejecutable de Pin (default: $PIN_ROOT/pin)" << std::endl;
+    std::cerr << "  --tool <path>        FaultInjector.so (default: obj-intel64/FaultInjector.so)" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Relanzar con el mismo --results retoma la campaña donde quedó." << std::endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    CampaignConfig cfg;
+    const char* pinRoot = std::getenv("PIN_ROOT");
+    cfg.pin = pinRoot ? string(pinRoot) + "/pin" : "pin/pin";
+    cfg.tool = "obj-intel64/FaultInjector.so";
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--") {
+            cfg.binaryArgs.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        if (i + 1 >= argc) {
+            return Usage();
+        }
+        string value = argv[++i];
+        if (arg == "--binary") {
+            cfg.binary = value;
+        } else if (arg == "--function") {
+            cfg.functions.push_back(value);
+        } else if (arg == "--opcode") {
+            cfg.opcodes.push_back(value);
+        } else if (arg == "--num-faults") {
+            cfg.numFaults = std::stoull(value);
+        } else if (arg == "--jobs") {
+            cfg.jobs = std::stoul(value);
+        } else if (arg == "--target") {
+            cfg.target = value;
+        } else if (arg == "--profile") {
+            cfg.profile = value;
+        } else if (arg == "--checkpoint") {
+            cfg.checkpoint = value;
+        } else if (arg == "--results") {
+            cfg.results = value;
+        } else if (arg == "--seed") {
+            cfg.seed = std::stoull(value);
+        } else if (arg == "--timeout-factor") {
+            cfg.timeoutFactor = std::stod(value);
+        } else if (arg == "--budget-factor") {
+            cfg.budgetFactor = std::stod(value);
+        } else if (arg == "--catch-signals") {
+            cfg.catchSignals = value != "0";
+        } else if (arg == "--workdir") {
+            cfg.workDir = value;
+        } else if (arg == "--pin") {
+            cfg.pin = value;
+        } else if (arg == "--tool") {
+            cfg.tool = value;
+        } else {
+            return Usage();
+        }
+    }
+    if (cfg.binary.empty() || cfg.numFaults == 0) {
+        return Usage();
+    }
+    if (cfg.jobs == 0) {
+        cfg.jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    mkdir(cfg.workDir.c_str(), 0755);
+
+    if (!cfg.checkpoint.empty() && !cfg.profile.empty()) {
+        // El sitio de --profile se elige al instrumentar: uno por proceso
+        std::cerr << "ERROR: --checkpoint no se combina con --profile" << std::endl;
+        return 1;
+    }
+    if (!cfg.profile.empty()) {
+        if (!ReadIpProfile(cfg.profile, profile) || profile.records.empty()) {
+            std::cerr << "ERROR: perfil por IP inválido o vacío: " << cfg.profile << std::endl;
+            return 1;
+        }
+        KeepInjectableSites(cfg.target);
+        if (profile.records.empty()) {
+            std::cerr << "ERROR: el perfil no tiene sitios para --target " << cfg.target << std::endl;
+            return 1;
+        }
+    }
+
+    // Retomar una campaña previa: se reusa su semilla e instancias para
+    // regenerar exactamente la misma lista de fallas
+    std::set<uint64_t> done;
+    vector<uint64_t> outcomeCounts(OUTCOME_NUM, 0);
+    uint64_t instances = 0;
+    bool resuming = LoadPreviousResults(cfg.results, instances, cfg.seed, done, outcomeCounts);
+
+    RunResult golden;
+    uint64_t goldenInstances = 0;
+    if (!GoldenRun(cfg, golden, goldenInstances)) {
+        return 1;
+    }
+    if (!resuming) {
+        instances = goldenInstances;
+    } else if (instances != goldenInstances) {
+        std::cerr << "AVISO: la corrida dorada ejecutó " << goldenInstances
+                  << " instancias y la campaña previa " << instances << std::endl;
+    }
+    double timeout = std::max(1.0, golden.seconds * cfg.timeoutFactor);
+
+    bool completeLastLine = EndsWithNewline(cfg.results);
+    std::ofstream results(cfg.results.c_str(), std::ios::app);
+    if (!results.is_open()) {
+        std::cerr << "ERROR: No se pudo abrir " << cfg.results << std::endl;
+        return 1;
+    }
+    if (!completeLastLine) {
+        results << std::endl;
+    }
+    if (!resuming) {
+        results << "# campaign binary=" << cfg.binary
+                << " instances=" << instances
+                << " seed=" << cfg.seed
+                << " profile=" << (cfg.profile.empty() ? "-" : cfg.profile)
+                << " faults=" << cfg.numFaults << std::endl;
+    }
+
+    vector<Fault> pending;
+    for (const Fault& f : GenerateFaults(cfg.numFaults, instances, cfg.seed)) {
+        if (!done.count(f.id)) {
+            pending.push_back(f);
+        }
+    }
+
+    std::cerr << "[INFO] " << instances << " instancias dinámicas, "
+              << pending.size() << " fallas pendientes ("
+              << done.size() << " ya terminadas), " << cfg.jobs << " procesos, "
+              << "timeout " << timeout << "s" << std::endl;
+
+    std::atomic<uint64_t> finished(0);
+    std::mutex resultsLock;
+    double start = NowSeconds();
+    double lastReport = start;
+
+    // Una línea por falla terminada; la llaman varios workers a la vez
+    auto record = [&](const Fault& fault, const RunResult& run) {
+        Outcome outcome = Classify(run, golden);
+
+        std::lock_guard<std::mutex> guard(resultsLock);
+        results << "id=" << fault.id
+                << " n=" << fault.instance
+                << " bit=" << fault.bit;
+        if (fault.record >= 0) {
+            const IpProfileRecord& r = profile.records[fault.record];
+            results << " image=" << profile.images[r.image]
+                    << " offset=0x" << std::hex << r.offset << std::dec;
+        }
+        results << " outcome=" << OutcomeNames[outcome]
+                << " code=" << run.code
+                << " seconds=" << run.seconds;
+        string injection = InjectionRecord(run.injectionLog);
+        if (!injection.empty()) {
+            results << " " << injection;
+        }
+        results << std::endl;
+        outcomeCounts[outcome]++;
+
+        uint64_t count = ++finished;
+        double now = NowSeconds();
+        if (now - lastReport >= 5.0 || count == pending.size()) {
+            lastReport = now;
+            std::cerr << "[INFO] " << count << "/" << pending.size()
+                      << " fallas, " << count / (now - start) << " fallas/s" << std::endl;
+        }
+    };
+
+    if (!cfg.checkpoint.empty()) {
+        // Fork-server: un lote por proceso Pin, con --jobs hijos a la vez
+        Fault model{0, 1, 0};
+        uint64_t batchSize = cfg.jobs * FORK_BATCH_PER_JOB;
+        uint64_t lost = 0;
+        for (uint64_t first = 0; first < pending.size(); first += batchSize) {
+            vector<Fault> batch(pending.begin() + first,
+                                pending.begin() + std::min<uint64_t>(first + batchSize, pending.size()));
+            vector<RunResult> runs = RunForkBatch(cfg, model, batch, timeout);
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (runs[i].lost) {
+                    lost++;
+                } else {
+                    record(batch[i], runs[i]);
+                }
+            }
+        }
+        if (lost > 0) {
+            std::cerr << "AVISO: " << lost << " fallas sin resultado del fork-server;"
+                      << " relanzar la campaña las reintenta" << std::endl;
+        }
+    } else {
+        // Pool de workers: cada uno toma la próxima falla del contador compartido
+        std::atomic<uint64_t> next(0);
+        auto worker = [&](unsigned w) {
+            string outPath = cfg.workDir + "/w" + std::to_string(w) + ".out";
+            string logPath = cfg.workDir + "/w" + std::to_string(w) + ".log";
+            while (true) {
+                uint64_t i = next.fetch_add(1);
+                if (i >= pending.size()) {
+                    break;
+                }
+                const Fault& fault = pending[i];
+                unlink(logPath.c_str());
+                RunResult run = RunProcess(InjectorCommand(cfg, fault, logPath),
+                                           outPath, timeout);
+                run.injectionLog = ReadFile(logPath);
+                record(fault, run);
+            }
+        };
+
+        vector<std::thread> pool;
+        for (unsigned w = 0; w < cfg.jobs; w++) {
+            pool.emplace_back(worker, w);
+        }
+        for (std::thread& t : pool) {
+            t.join();
+        }
+    }
+
+    double elapsed = NowSeconds() - start;
+    std::cout << "Fallas: " << done.size() + finished.load() << "/" << cfg.numFaults << std::endl;
+    for (int o = 0; o < OUTCOME_NUM; o++) {
+        std::cout << "  " << OutcomeNames[o] << ": " << outcomeCounts[o] << std::endl;
+    }
+    std::cout << "Throughput: " << (elapsed > 0 ? finished.load() / elapsed : 0.0)
+              << " fallas/s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,146 @@
+#ifndef CRYPTO_INJECTOR_ALIAS_SAMPLER_H
+#define CRYPTO_INJECTOR_ALIAS_SAMPLER_H
+
+// Muestreo ponderado en O(1) con el método de alias (Vose).
+//
+// Se construye en O(n) sobre los conteos dinámicos de un perfil por IP; cada
+// sorteo es una columna uniforme y una comparación. SampleSite agrega la
+// instancia dinámica uniforme dentro de la IP elegida, así el par
+// (IP, instancia) queda uniforme sobre todas las ejecuciones del perfil.
+
+#include "ip_profile.h"
+#include <cstdint>
+#include <vector>
+
+// SplitMix64: rápido y con buena dispersión para sorteos de campaña
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+    uint64_t Next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Entero uniforme en [0, n) (multiplicación de 128 bits, sin división)
+    uint64_t Below(uint64_t n) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(Next()) * n) >> 64);
+    }
+
+private:
+    uint64_t state;
+};
+
+class AliasSampler {
+public:
+    AliasSampler() = default;
+
+    explicit AliasSampler(const std::vector<uint64_t>& weights) {
+        Build(weights);
+    }
+
+    void Build(const std::vector<uint64_t>& weights) {
+        size_t n = weights.size();
+        buckets.assign(n, Bucket());
+        if (n == 0) {
+            return;
+        }
+
+        long double total = 0;
+        for (uint64_t w : weights) {
+            total += w;
+        }
+        if (total == 0) {
+            for (size_t i = 0; i < n; i++) {
+                SetBucket(i, 1.0, i);
+            }
+            return;
+        }
+
+        // Probabilidades escaladas a media 1; small/large como pilas de índices
+        std::vector<double> scaled(n);
+        std::vector<uint32_t> small;
+        std::vector<uint32_t> large;
+        small.reserve(n);
+        large.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            scaled[i] = static_cast<double>(weights[i] * static_cast<long double>(n) / total);
+            (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+
+        while (!small.empty() && !large.empty()) {
+            uint32_t s = small.back();
+            small.pop_back();
+            uint32_t l = large.back();
+
+            SetBucket(s, scaled[s], l);
+            scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+            if (scaled[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // Restos por redondeo: probabilidad 1
+        for (uint32_t i : large) {
+            SetBucket(i, 1.0, i);
+        }
+        for (uint32_t i : small) {
+            SetBucket(i, 1.0, i);
+        }
+    }
+
+    size_t Size() const {
+        return buckets.size();
+    }
+
+    size_t Sample(SplitMix64& rng) const {
+        const Bucket& b = buckets[rng.Below(buckets.size())];
+        return rng.Next() < b.threshold ? b.self : b.alias;
+    }
+
+private:
+    // Columna, umbral y alias juntos: un sorteo toca una sola línea de cache.
+    // El umbral es la probabilidad de quedarse escalada a 2^64
+    struct Bucket {
+        uint64_t threshold = 0;
+        uint32_t self = 0;
+        uint32_t alias = 0;
+    };
+
+    void SetBucket(size_t i, double p, size_t aliasIndex) {
+        Bucket& b = buckets[i];
+        b.threshold = p >= 1.0 ? UINT64_MAX : static_cast<uint64_t>(p * 18446744073709551616.0);
+        b.self = static_cast<uint32_t>(i);
+        b.alias = static_cast<uint32_t>(aliasIndex);
+    }
+
+    std::vector<Bucket> buckets;
+};
+
+// Sitio de falla sorteado: registro del perfil e instancia dinámica (1-based)
+struct SampledSite {
+    size_t record;
+    uint64_t instance;
+};
+
+// El sampler debe haberse construido sobre los count de profile.records
+inline SampledSite SampleSite(const AliasSampler& sampler, const IpProfile& profile,
+                              SplitMix64& rng) {
+    SampledSite site;
+    site.record = sampler.Sample(rng);
+    site.instance = 1 + rng.Below(profile.records[site.record].count);
+    return site;
+}
+
+inline AliasSampler BuildSiteSampler(const IpProfile& profile) {
+    std::vector<uint64_t> weights;
+    weights.reserve(profile.records.size());
+    for (const IpProfileRecord& r : profile.records) {
+        weights.push_back(r.count);
+    }
+    return AliasSampler(weights);
+}
+
+#endif // CRYPTO_INJECTOR_ALIAS_SAMPLER_H
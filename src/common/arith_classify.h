@@ -0,0 +1,237 @@
+#ifndef CRYPTO_INJECTOR_ARITH_CLASSIFY_H
+#define CRYPTO_INJECTOR_ARITH_CLASSIFY_H
+
+// Clasificación de instrucciones aritméticas compartida por el profiler
+// (inst_counter) y el inyector (FaultInjector), para que ambos seleccionen
+// exactamente las mismas instrucciones.
+
+#include "pin.H"
+#include <initializer_list>
+#include <string>
+#include <cctype>
+
+// Tipos de instrucciones aritméticas
+enum ArithType {
+    ARITH_ADD,
+    ARITH_SUB,
+    ARITH_MUL,
+    ARITH_DIV,
+    ARITH_INC,
+    ARITH_DEC,
+    ARITH_NEG,
+    ARITH_IMUL,
+    ARITH_IDIV,
+    // Entera multi-precisión (aritmética modular nativa de 64 bits)
+    ARITH_ADC,
+    ARITH_SBB,
+    ARITH_MULX,
+    // SIMD Integer
+    ARITH_SIMD_ADD,
+    ARITH_SIMD_SUB,
+    ARITH_SIMD_MUL,
+    ARITH_SIMD_MADD52,
+    // AVX/SSE Floating Point
+    ARITH_SSE_ADD,
+    ARITH_SSE_SUB,
+    ARITH_SSE_MUL,
+    ARITH_SSE_DIV,
+    ARITH_AVX_ADD,
+    ARITH_AVX_SUB,
+    ARITH_AVX_MUL,
+    ARITH_AVX_DIV,
+    ARITH_FMA,
+    // FPU
+    ARITH_FPU_ADD,
+    ARITH_FPU_SUB,
+    ARITH_FPU_MUL,
+    ARITH_FPU_DIV,
+    ARITH_UNKNOWN,
+    ARITH_NUM_TYPES
+};
+
+// Mapa de nombres para cada tipo
+inline const char* const ArithTypeNames[] = {
+    "ADD", "SUB", "MUL", "DIV", "INC", "DEC", "NEG", "IMUL", "IDIV",
+    "ADC", "SBB", "MULX",
+    "SIMD_ADD", "SIMD_SUB", "SIMD_MUL", "SIMD_MADD52",
+    "SSE_ADD", "SSE_SUB", "SSE_MUL", "SSE_DIV",
+    "AVX_ADD", "AVX_SUB", "AVX_MUL", "AVX_DIV", "FMA",
+    "FPU_ADD", "FPU_SUB", "FPU_MUL", "FPU_DIV",
+    "UNKNOWN"
+};
+static_assert(sizeof(ArithTypeNames) / sizeof(ArithTypeNames[0]) == ARITH_NUM_TYPES,
+              "ArithTypeNames debe tener un nombre por ArithType");
+
+// Tabla de clasificación indexada por iclass de XED. Se construye en tiempo
+// de compilación, así clasificar una instrucción es una sola lectura.
+// Las codificaciones VEX y EVEX (xmm/ymm/zmm) comparten iclass, así que las
+// entradas V* cubren AVX/AVX2 y AVX-512 (p. ej. VPMULUDQ zmm).
+struct ArithClassTable {
+    UINT8 type[XED_ICLASS_LAST];
+};
+static_assert(ARITH_NUM_TYPES <= 256, "ArithType no entra en UINT8");
+
+constexpr void SetArithClass(ArithClassTable& table,
+                             std::initializer_list<UINT32> iclasses,
+                             ArithType type) {
+    for (UINT32 iclass : iclasses) {
+        table.type[iclass] = type;
+    }
+}
+
+constexpr ArithClassTable BuildArithClassTable() {
+    ArithClassTable table{};
+    for (UINT32 i = 0; i < XED_ICLASS_LAST; i++) {
+        table.type[i] = ARITH_UNKNOWN;
+    }
+
+    // Instrucciones enteras básicas
+    SetArithClass(table, {XED_ICLASS_ADD}, ARITH_ADD);
+    SetArithClass(table, {XED_ICLASS_SUB}, ARITH_SUB);
+    SetArithClass(table, {XED_ICLASS_MUL}, ARITH_MUL);
+    SetArithClass(table, {XED_ICLASS_DIV}, ARITH_DIV);
+    SetArithClass(table, {XED_ICLASS_INC}, ARITH_INC);
+    SetArithClass(table, {XED_ICLASS_DEC}, ARITH_DEC);
+    SetArithClass(table, {XED_ICLASS_NEG}, ARITH_NEG);
+    SetArithClass(table, {XED_ICLASS_IMUL}, ARITH_IMUL);
+    SetArithClass(table, {XED_ICLASS_IDIV}, ARITH_IDIV);
+
+    // Multi-precisión: acarreos y MULX (BMI2) de la aritmética modular
+    SetArithClass(table, {XED_ICLASS_ADC, XED_ICLASS_ADCX, XED_ICLASS_ADOX}, ARITH_ADC);
+    SetArithClass(table, {XED_ICLASS_SBB}, ARITH_SBB);
+    SetArithClass(table, {XED_ICLASS_MULX}, ARITH_MULX);
+
+    // SIMD Integer (SSE2/AVX2/AVX-512)
+    SetArithClass(table, {XED_ICLASS_PADDB, XED_ICLASS_PADDW,
+                          XED_ICLASS_PADDD, XED_ICLASS_PADDQ,
+                          XED_ICLASS_VPADDB, XED_ICLASS_VPADDW,
+                          XED_ICLASS_VPADDD, XED_ICLASS_VPADDQ}, ARITH_SIMD_ADD);
+
+    SetArithClass(table, {XED_ICLASS_PSUBB, XED_ICLASS_PSUBW,
+                          XED_ICLASS_PSUBD, XED_ICLASS_PSUBQ,
+                          XED_ICLASS_VPSUBB, XED_ICLASS_VPSUBW,
+                          XED_ICLASS_VPSUBD, XED_ICLASS_VPSUBQ}, ARITH_SIMD_SUB);
+
+    SetArithClass(table, {XED_ICLASS_PMULLW, XED_ICLASS_PMULLD,
+                          XED_ICLASS_VPMULLW, XED_ICLASS_VPMULLD,
+                          XED_ICLASS_VPMULLQ,
+                          XED_ICLASS_PMULUDQ, XED_ICLASS_VPMULUDQ,
+                          XED_ICLASS_PMULDQ, XED_ICLASS_VPMULDQ}, ARITH_SIMD_MUL);
+
+    // AVX-512 IFMA (multiplicación-suma de 52 bits)
+    SetArithClass(table, {XED_ICLASS_VPMADD52LUQ, XED_ICLASS_VPMADD52HUQ},
+                  ARITH_SIMD_MADD52);
+
+    // SSE Floating Point
+    SetArithClass(table, {XED_ICLASS_ADDSS, XED_ICLASS_ADDSD,
+                          XED_ICLASS_ADDPS, XED_ICLASS_ADDPD}, ARITH_SSE_ADD);
+    SetArithClass(table, {XED_ICLASS_SUBSS, XED_ICLASS_SUBSD,
+                          XED_ICLASS_SUBPS, XED_ICLASS_SUBPD}, ARITH_SSE_SUB);
+    SetArithClass(table, {XED_ICLASS_MULSS, XED_ICLASS_MULSD,
+                          XED_ICLASS_MULPS, XED_ICLASS_MULPD}, ARITH_SSE_MUL);
+    SetArithClass(table, {XED_ICLASS_DIVSS, XED_ICLASS_DIVSD,
+                          XED_ICLASS_DIVPS, XED_ICLASS_DIVPD}, ARITH_SSE_DIV);
+
+    // AVX Floating Point
+    SetArithClass(table, {XED_ICLASS_VADDSS, XED_ICLASS_VADDSD,
+                          XED_ICLASS_VADDPS, XED_ICLASS_VADDPD}, ARITH_AVX_ADD);
+    SetArithClass(table, {XED_ICLASS_VSUBSS, XED_ICLASS_VSUBSD,
+                          XED_ICLASS_VSUBPS, XED_ICLASS_VSUBPD}, ARITH_AVX_SUB);
+    SetArithClass(table, {XED_ICLASS_VMULSS, XED_ICLASS_VMULSD,
+                          XED_ICLASS_VMULPS, XED_ICLASS_VMULPD}, ARITH_AVX_MUL);
+    SetArithClass(table, {XED_ICLASS_VDIVSS, XED_ICLASS_VDIVSD,
+                          XED_ICLASS_VDIVPS, XED_ICLASS_VDIVPD}, ARITH_AVX_DIV);
+
+    // FMA3 (VFMADD/VFMSUB/VFNMADD/VFNMSUB y las variantes alternadas)
+    SetArithClass(table, {
+        XED_ICLASS_VFMADD132PD, XED_ICLASS_VFMADD132PS, XED_ICLASS_VFMADD132SD, XED_ICLASS_VFMADD132SS,
+        XED_ICLASS_VFMADD213PD, XED_ICLASS_VFMADD213PS, XED_ICLASS_VFMADD213SD, XED_ICLASS_VFMADD213SS,
+        XED_ICLASS_VFMADD231PD, XED_ICLASS_VFMADD231PS, XED_ICLASS_VFMADD231SD, XED_ICLASS_VFMADD231SS,
+        XED_ICLASS_VFMSUB132PD, XED_ICLASS_VFMSUB132PS, XED_ICLASS_VFMSUB132SD, XED_ICLASS_VFMSUB132SS,
+        XED_ICLASS_VFMSUB213PD, XED_ICLASS_VFMSUB213PS, XED_ICLASS_VFMSUB213SD, XED_ICLASS_VFMSUB213SS,
+        XED_ICLASS_VFMSUB231PD, XED_ICLASS_VFMSUB231PS, XED_ICLASS_VFMSUB231SD, XED_ICLASS_VFMSUB231SS,
+        XED_ICLASS_VFNMADD132PD, XED_ICLASS_VFNMADD132PS, XED_ICLASS_VFNMADD132SD, XED_ICLASS_VFNMADD132SS,
+        XED_ICLASS_VFNMADD213PD, XED_ICLASS_VFNMADD213PS, XED_ICLASS_VFNMADD213SD, XED_ICLASS_VFNMADD213SS,
+        XED_ICLASS_VFNMADD231PD, XED_ICLASS_VFNMADD231PS, XED_ICLASS_VFNMADD231SD, XED_ICLASS_VFNMADD231SS,
+        XED_ICLASS_VFNMSUB132PD, XED_ICLASS_VFNMSUB132PS, XED_ICLASS_VFNMSUB132SD, XED_ICLASS_VFNMSUB132SS,
+        XED_ICLASS_VFNMSUB213PD, XED_ICLASS_VFNMSUB213PS, XED_ICLASS_VFNMSUB213SD, XED_ICLASS_VFNMSUB213SS,
+        XED_ICLASS_VFNMSUB231PD, XED_ICLASS_VFNMSUB231PS, XED_ICLASS_VFNMSUB231SD, XED_ICLASS_VFNMSUB231SS,
+        XED_ICLASS_VFMADDSUB132PD, XED_ICLASS_VFMADDSUB132PS,
+        XED_ICLASS_VFMADDSUB213PD, XED_ICLASS_VFMADDSUB213PS,
+        XED_ICLASS_VFMADDSUB231PD, XED_ICLASS_VFMADDSUB231PS,
+        XED_ICLASS_VFMSUBADD132PD, XED_ICLASS_VFMSUBADD132PS,
+        XED_ICLASS_VFMSUBADD213PD, XED_ICLASS_VFMSUBADD213PS,
+        XED_ICLASS_VFMSUBADD231PD, XED_ICLASS_VFMSUBADD231PS}, ARITH_FMA);
+
+    // FPU x87
+    SetArithClass(table, {XED_ICLASS_FADD, XED_ICLASS_FADDP,
+                          XED_ICLASS_FIADD}, ARITH_FPU_ADD);
+    SetArithClass(table, {XED_ICLASS_FSUB, XED_ICLASS_FSUBP,
+                          XED_ICLASS_FISUB, XED_ICLASS_FSUBR,
+                          XED_ICLASS_FSUBRP}, ARITH_FPU_SUB);
+    SetArithClass(table, {XED_ICLASS_FMUL, XED_ICLASS_FMULP,
+                          XED_ICLASS_FIMUL}, ARITH_FPU_MUL);
+    SetArithClass(table, {XED_ICLASS_FDIV, XED_ICLASS_FDIVP,
+                          XED_ICLASS_FIDIV, XED_ICLASS_FDIVR,
+                          XED_ICLASS_FDIVRP}, ARITH_FPU_DIV);
+
+    return table;
+}
+
+inline constexpr ArithClassTable arithClassTable = BuildArithClassTable();
+
+// Clasificar una instrucción aritmética (ARITH_UNKNOWN si no lo es)
+inline ArithType ClassifyArithmeticInstruction(INS ins) {
+    OPCODE opcode = INS_Opcode(ins);
+    if (opcode >= XED_ICLASS_LAST) {
+        return ARITH_UNKNOWN;
+    }
+    return static_cast<ArithType>(arithClassTable.type[opcode]);
+}
+
+// Tipo por nombre ("SIMD_MUL", sin distinguir mayúsculas); ARITH_UNKNOWN si no existe
+inline ArithType ArithTypeFromName(const std::string& name) {
+    std::string upper(name);
+    for (char& c : upper) {
+        c = std::toupper(static_cast<unsigned char>(c));
+    }
+    for (UINT32 t = 0; t < ARITH_UNKNOWN; t++) {
+        if (upper == ArithTypeNames[t]) {
+            return static_cast<ArithType>(t);
+        }
+    }
+    return ARITH_UNKNOWN;
+}
+
+// Registro destino de la inyección: el operando 0 si es un registro
+// escrito; si no, el primer registro escrito implícito (ej: RAX en MUL, DIV
+// e IMUL de un operando, que escriben RDX:RAX), sin flags, RSP ni RIP.
+// REG_INVALID si la instrucción solo escribe a memoria.
+inline REG InjectionDestinationRegister(INS ins) {
+    if (INS_OperandCount(ins) > 0 && INS_OperandIsReg(ins, 0) && INS_OperandWritten(ins, 0)) {
+        return INS_OperandReg(ins, 0);
+    }
+    for (UINT32 i = 0; i < INS_MaxNumWRegs(ins); i++) {
+        REG reg = INS_RegW(ins, i);
+        REG full = REG_FullRegName(reg);
+        if (REG_valid(reg) && !REG_is_flags(reg) &&
+            full != REG_STACK_PTR && full != REG_INST_PTR) {
+            return reg;
+        }
+    }
+    return REG_INVALID();
+}
+
+// ¿Puede el inyector corromper el registro destino (-target reg) o la
+// escritura a memoria (-target mem)? Ambos se observan en IPOINT_AFTER.
+// El profiler lo anota en el perfil por IP con la misma regla
+inline bool HasInjectableRegister(INS ins) {
+    REG reg = InjectionDestinationRegister(ins);
+    return INS_IsValidForIpointAfter(ins) && REG_valid(reg) && !REG_is_flags(reg);
+}
+
+inline bool HasInjectableWrite(INS ins) {
+    return INS_IsValidForIpointAfter(ins) && INS_IsMemoryWrite(ins);
+}
+
+#endif // CRYPTO_INJECTOR_ARITH_CLASSIFY_H
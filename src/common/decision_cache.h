@@ -0,0 +1,310 @@
+#ifndef CRYPTO_INJECTOR_DECISION_CACHE_H
+#define CRYPTO_INJECTOR_DECISION_CACHE_H
+
+// Cache en disco de las decisiones de instrumentación de una imagen.
+//
+// Recorrer todas las rutinas de libOPENFHEcore/pke (RTN_Name, filtro,
+// clasificación de cada instrucción) da siempre el mismo resultado para la
+// misma biblioteca y las mismas opciones. La primera corrida guarda qué
+// rutinas y qué instrucciones se instrumentan; las siguientes mapean el
+// archivo y abren solo esas rutinas.
+//
+// Clave: build-id GNU de la imagen (notas PT_NOTE del ELF) y un hash de
+// las opciones que afectan la decisión. Sin build-id no se cachea.
+//
+// Formato (little endian, tal cual en memoria):
+//   DecisionCacheHeader | DecisionRoutine[] | DecisionSite[] | nombres
+// Los sitios de cada rutina son contiguos y están ordenados por offset.
+// Los offsets son desde IMG_LowAddress, como en ip_profile.h.
+// No depende de Pin.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char DECISION_CACHE_MAGIC[8] = {'C', 'I', 'D', 'E', 'C', 'A', 'C', 'H'};
+const uint32_t DECISION_CACHE_VERSION = 1;
+
+struct DecisionCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numRoutines;
+    uint64_t numSites;
+    uint64_t namesBytes;
+    uint64_t optionsHash;   // repetido del nombre de archivo: descarta colisiones de ruta
+};
+
+struct DecisionRoutine {
+    uint64_t offset;        // entrada de la rutina desde IMG_LowAddress
+    uint32_t name;          // offset en la tabla de nombres ('\0' terminados)
+    uint32_t firstSite;
+    uint32_t numSites;
+    uint32_t reserved;
+};
+
+struct DecisionSite {
+    uint64_t offset;        // instrucción desde IMG_LowAddress
+    uint32_t arithType;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(DecisionCacheHeader) == 40, "DecisionCacheHeader debe ser compacto");
+static_assert(sizeof(DecisionRoutine) == 24, "DecisionRoutine debe ser compacto");
+static_assert(sizeof(DecisionSite) == 16, "DecisionSite debe ser compacto");
+
+// FNV-1a de 64 bits
+inline uint64_t HashOptions(const std::string& options) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (unsigned char c : options) {
+        h = (h ^ c) * 0x100000001B3ULL;
+    }
+    return h;
+}
+
+// Build-id GNU en hexadecimal; vacío si el archivo no es un ELF64 o no tiene
+inline std::string ReadElfBuildId(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return "";
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Elf64_Ehdr)) {
+        close(fd);
+        return "";
+    }
+    size_t size = st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return "";
+    }
+
+    std::string id;
+    const unsigned char* base = static_cast<const unsigned char*>(map);
+    const Elf64_Ehdr* eh = reinterpret_cast<const Elf64_Ehdr*>(base);
+    bool valid = std::memcmp(eh->e_ident, ELFMAG, SELFMAG) == 0 &&
+                 eh->e_ident[EI_CLASS] == ELFCLASS64 &&
+                 eh->e_phoff + static_cast<uint64_t>(eh->e_phnum) * sizeof(Elf64_Phdr) <= size;
+
+    // Las notas se buscan por segmento (PT_NOTE): sobreviven a strip
+    for (uint32_t p = 0; valid && id.empty() && p < eh->e_phnum; p++) {
+        const Elf64_Phdr* ph = reinterpret_cast<const Elf64_Phdr*>(base + eh->e_phoff) + p;
+        if (ph->p_type != PT_NOTE || ph->p_offset + ph->p_filesz > size) {
+            continue;
+        }
+        uint64_t pos = ph->p_offset;
+        uint64_t end = ph->p_offset + ph->p_filesz;
+        while (pos + sizeof(Elf64_Nhdr) <= end) {
+            const Elf64_Nhdr* note = reinterpret_cast<const Elf64_Nhdr*>(base + pos);
+            uint64_t name = pos + sizeof(Elf64_Nhdr);
+            uint64_t desc = name + ((note->n_namesz + 3) & ~3ULL);
+            uint64_t next = desc + ((note->n_descsz + 3) & ~3ULL);
+            if (next > end) {
+                break;
+            }
+            if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 &&
+                std::memcmp(base + name, "GNU", 4) == 0) {
+                static const char hex[] = "0123456789abcdef";
+                for (uint32_t i = 0; i < note->n_descsz; i++) {
+                    id += hex[base[desc + i] >> 4];
+                    id += hex[base[desc + i] & 0xF];
+                }
+                break;
+            }
+            pos = next;
+        }
+    }
+
+    munmap(map, size);
+    return id;
+}
+
+inline std::string DecisionCachePath(const std::string& dir, const std::string& buildId,
+                                     uint64_t optionsHash) {
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(optionsHash));
+    return dir + "/" + buildId + "-" + hash + ".dcache";
+}
+
+// Acumula las decisiones de una imagen durante el recorrido completo
+class DecisionCacheBuilder {
+public:
+    void BeginRoutine(uint64_t offset, const std::string& name) {
+        DecisionRoutine r = {};
+        r.offset = offset;
+        r.name = static_cast<uint32_t>(names.size());
+        r.firstSite = static_cast<uint32_t>(sites.size());
+        routines.push_back(r);
+        names.append(name);
+        names.push_back('\0');
+    }
+
+    void AddSite(uint64_t offset, uint32_t arithType) {
+        DecisionSite s = {};
+        s.offset = offset;
+        s.arithType = arithType;
+        sites.push_back(s);
+        routines.back().numSites++;
+    }
+
+    // Rutina sin sitios: no vale la pena abrirla en las próximas corridas
+    void EndRoutine() {
+        if (!routines.empty() && routines.back().numSites == 0) {
+            names.resize(routines.back().name);
+            routines.pop_back();
+        }
+    }
+
+    // Escribe en un temporal y renombra: corridas en paralelo que escriben
+    // la misma entrada nunca dejan un archivo a medias
+    bool Write(const std::string& path, uint64_t optionsHash) const {
+        std::string tmp = path + ".tmp." + std::to_string(getpid());
+        FILE* f = std::fopen(tmp.c_str(), "wb");
+        if (f == nullptr) {
+            return false;
+        }
+
+        DecisionCacheHeader h = {};
+        std::memcpy(h.magic, DECISION_CACHE_MAGIC, sizeof(h.magic));
+        h.version = DECISION_CACHE_VERSION;
+        h.numRoutines = static_cast<uint32_t>(routines.size());
+        h.numSites = sites.size();
+        h.namesBytes = names.size();
+        h.optionsHash = optionsHash;
+
+        bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+                  (routines.empty() ||
+                   std::fwrite(routines.data(), sizeof(DecisionRoutine), routines.size(), f) == routines.size()) &&
+                  (sites.empty() ||
+                   std::fwrite(sites.data(), sizeof(DecisionSite), sites.size(), f) == sites.size()) &&
+                  (names.empty() || std::fwrite(names.data(), 1, names.size(), f) == names.size());
+        ok = std::fclose(f) == 0 && ok;
+
+        if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<DecisionRoutine> routines;
+    std::vector<DecisionSite> sites;
+    std::string names;
+};
+
+// Vista de solo lectura sobre un archivo de cache mapeado en memoria
+class DecisionCacheView {
+public:
+    DecisionCacheView() = default;
+    DecisionCacheView(const DecisionCacheView&) = delete;
+    DecisionCacheView& operator=(const DecisionCacheView&) = delete;
+
+    ~DecisionCacheView() {
+        Close();
+    }
+
+    // Mapea y valida el archivo completo: si algún índice apunta fuera de
+    // sus tablas el cache se descarta y el injector hace el recorrido completo
+    bool Open(const std::string& path, uint64_t optionsHash, uint32_t numArithTypes) {
+        Close();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(DecisionCacheHeader)) {
+            close(fd);
+            return false;
+        }
+        void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (m == MAP_FAILED) {
+            return false;
+        }
+        map = m;
+        mapSize = st.st_size;
+
+        const DecisionCacheHeader* h = static_cast<const DecisionCacheHeader*>(map);
+        if (std::memcmp(h->magic, DECISION_CACHE_MAGIC, sizeof(h->magic)) != 0 ||
+            h->version != DECISION_CACHE_VERSION || h->optionsHash != optionsHash) {
+            Close();
+            return false;
+        }
+        // Cada tabla por separado antes de sumar, para que el tamaño
+        // esperado no desborde con contadores corruptos
+        uint64_t body = mapSize - sizeof(DecisionCacheHeader);
+        if (h->numRoutines > body / sizeof(DecisionRoutine) ||
+            h->numSites > body / sizeof(DecisionSite) || h->namesBytes > body) {
+            Close();
+            return false;
+        }
+        uint64_t expected = sizeof(DecisionCacheHeader) +
+                            static_cast<uint64_t>(h->numRoutines) * sizeof(DecisionRoutine) +
+                            h->numSites * sizeof(DecisionSite) + h->namesBytes;
+        const char* blob = static_cast<const char*>(map) + (mapSize - h->namesBytes);
+        if (expected != mapSize || (h->namesBytes > 0 && blob[h->namesBytes - 1] != '\0')) {
+            Close();
+            return false;
+        }
+
+        const DecisionRoutine* r = reinterpret_cast<const DecisionRoutine*>(h + 1);
+        const DecisionSite* s = reinterpret_cast<const DecisionSite*>(r + h->numRoutines);
+        for (uint32_t i = 0; i < h->numRoutines; i++) {
+            if (static_cast<uint64_t>(r[i].firstSite) + r[i].numSites > h->numSites ||
+                r[i].name >= h->namesBytes) {
+                Close();
+                return false;
+            }
+            // InstrumentFromCache recorre los sitios de una rutina en orden
+            const DecisionSite* rs = s + r[i].firstSite;
+            for (uint32_t j = 0; j < r[i].numSites; j++) {
+                if (rs[j].arithType >= numArithTypes ||
+                    (j > 0 && rs[j].offset <= rs[j - 1].offset)) {
+                    Close();
+                    return false;
+                }
+            }
+        }
+
+        header = h;
+        routines = r;
+        sites = s;
+        names = reinterpret_cast<const char*>(sites + header->numSites);
+        return true;
+    }
+
+    void Close() {
+        if (map != nullptr) {
+            munmap(map, mapSize);
+        }
+        map = nullptr;
+        mapSize = 0;
+        header = nullptr;
+        routines = nullptr;
+        sites = nullptr;
+        names = nullptr;
+    }
+
+    uint32_t NumRoutines() const { return header->numRoutines; }
+    const DecisionRoutine& Routine(uint32_t i) const { return routines[i]; }
+    const DecisionSite* Sites(const DecisionRoutine& r) const { return sites + r.firstSite; }
+    const char* Name(const DecisionRoutine& r) const { return names + r.name; }
+
+private:
+    void* map = nullptr;
+    size_t mapSize = 0;
+    const DecisionCacheHeader* header = nullptr;
+    const DecisionRoutine* routines = nullptr;
+    const DecisionSite* sites = nullptr;
+    const char* names = nullptr;
+};
+
+#endif // CRYPTO_INJECTOR_DECISION_CACHE_H
@@ -0,0 +1,395 @@
+#ifndef CRYPTO_INJECTOR_FUNCTION_FILTER_H
+#define CRYPTO_INJECTOR_FUNCTION_FILTER_H
+
+// Filtro de funciones (-f, -f_regex, -f_exclude) compartido por el profiler
+// y el inyector.
+//
+// Se compila una vez al arrancar (Compile): las subcadenas de -f y de
+// -f_exclude quedan en dos autómatas Aho-Corasick, así cada rutina se
+// decide con una sola pasada sobre su nombre sin importar cuántos patrones
+// haya. Las expresiones de -f_regex se precompilan a una secuencia de
+// átomos y se simulan como NFA (tiempo lineal, sin backtracking).
+//
+// Una rutina interesa si no hay patrones de inclusión o alguno (subcadena
+// o regex) aparece en alguno de sus nombres, y ningún patrón de exclusión
+// aparece. Los nombres probados son el mangled, el demangled y el demangled
+// sin argumentos de template, para que "lbcrypto::CryptoContextImpl::EvalMult"
+// encuentre lbcrypto::CryptoContextImpl<lbcrypto::DCRTPolyImpl<...>>::EvalMult.
+//
+// Sintaxis de -f_regex (subconjunto de ERE, sin alternación: repetir la
+// opción): literales, '.', clases [a-z_] y [^...], \d \w \s, '\' para
+// escapar, cuantificadores * + ? y anclas ^ $. Sin std::regex: las pintools
+// se compilan sin excepciones y el CRT de Pin no trae locales.
+// No depende de Pin.
+
+#include <bitset>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Autómata Aho-Corasick con alfabeto comprimido: solo los bytes que aparecen
+// en algún patrón tienen clase propia (el resto comparte la clase 0, que
+// siempre vuelve a la raíz), así la tabla de transiciones es densa y chica
+class SubstringAutomaton {
+public:
+    void Add(const std::string& pattern) {
+        if (!pattern.empty()) {
+            patterns.push_back(pattern);
+        }
+    }
+
+    bool Empty() const {
+        return patterns.empty();
+    }
+
+    void Compile() {
+        for (int b = 0; b < 256; b++) {
+            classOf[b] = 0;
+        }
+        numClasses = 1;
+        for (const std::string& p : patterns) {
+            for (unsigned char c : p) {
+                if (classOf[c] == 0) {
+                    classOf[c] = numClasses++;
+                }
+            }
+        }
+
+        // Trie: NONE marca transiciones todavía no definidas
+        const uint32_t NONE = ~0U;
+        next.assign(numClasses, NONE);
+        accept.assign(1, 0);
+        for (const std::string& p : patterns) {
+            uint32_t state = 0;
+            for (unsigned char c : p) {
+                uint32_t& edge = next[state * numClasses + classOf[c]];
+                if (edge == NONE) {
+                    edge = static_cast<uint32_t>(accept.size());
+                    accept.push_back(0);
+                    next.resize(next.size() + numClasses, NONE);
+                }
+                state = next[state * numClasses + classOf[c]];
+            }
+            accept[state] = 1;
+        }
+
+        // Enlaces de falla por BFS, completando la tabla como DFA
+        std::vector<uint32_t> fail(accept.size(), 0);
+        std::deque<uint32_t> queue;
+        for (uint32_t c = 0; c < numClasses; c++) {
+            uint32_t& edge = next[c];
+            if (edge == NONE) {
+                edge = 0;
+            } else {
+                queue.push_back(edge);
+            }
+        }
+        while (!queue.empty()) {
+            uint32_t state = queue.front();
+            queue.pop_front();
+            for (uint32_t c = 0; c < numClasses; c++) {
+                uint32_t& edge = next[state * numClasses + c];
+                uint32_t fallback = next[fail[state] * numClasses + c];
+                if (edge == NONE) {
+                    edge = fallback;
+                } else {
+                    fail[edge] = fallback;
+                    accept[edge] |= accept[fallback];
+                    queue.push_back(edge);
+                }
+            }
+        }
+    }
+
+    // ¿Aparece algún patrón en text? Requiere Compile
+    bool Search(const std::string& text) const {
+        if (patterns.empty()) {
+            return false;
+        }
+        uint32_t state = 0;
+        for (unsigned char c : text) {
+            state = next[state * numClasses + classOf[c]];
+            if (accept[state]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::string> patterns;
+    uint32_t classOf[256];
+    uint32_t numClasses = 1;
+    std::vector<uint32_t> next;     // estado * numClasses + clase -> estado
+    std::vector<uint8_t> accept;
+};
+
+// Expresión de -f_regex precompilada: secuencia de átomos (conjunto de
+// bytes aceptados) con su cuantificador
+class NameRegex {
+public:
+    // Devuelve false si la expresión está mal formada
+    bool Compile(const std::string& pattern) {
+        atoms.clear();
+        anchorStart = false;
+        anchorEnd = false;
+
+        size_t i = 0;
+        if (i < pattern.size() && pattern[i] == '^') {
+            anchorStart = true;
+            i++;
+        }
+        while (i < pattern.size()) {
+            char c = pattern[i];
+            if (c == '$' && i + 1 == pattern.size()) {
+                anchorEnd = true;
+                break;
+            }
+
+            Atom atom;
+            if (c == '*' || c == '+' || c == '?') {
+                return false;   // cuantificador sin átomo
+            } else if (c == '.') {
+                atom.accepts.set();
+                i++;
+            } else if (c == '[') {
+                if (!ParseClass(pattern, i, atom.accepts)) {
+                    return false;
+                }
+            } else if (c == '\\') {
+                if (i + 1 >= pattern.size()) {
+                    return false;
+                }
+                AddEscape(pattern[i + 1], atom.accepts);
+                i += 2;
+            } else {
+                atom.accepts.set(static_cast<unsigned char>(c));
+                i++;
+            }
+
+            if (i < pattern.size() && (pattern[i] == '*' || pattern[i] == '+' || pattern[i] == '?')) {
+                atom.quantifier = pattern[i];
+                i++;
+            }
+            atoms.push_back(atom);
+        }
+        return true;
+    }
+
+    // Búsqueda (no anclada salvo ^/$) simulando el NFA: active[k] indica que
+    // los primeros k átomos ya se reconocieron
+    bool Search(const std::string& text) const {
+        size_t n = atoms.size();
+        std::vector<uint8_t> active(n + 1, 0);
+        std::vector<uint8_t> following(n + 1, 0);
+        active[0] = 1;
+        Close(active);
+        if (Accepting(active, text.empty())) {
+            return true;
+        }
+
+        for (size_t pos = 0; pos < text.size(); pos++) {
+            unsigned char c = text[pos];
+            std::fill(following.begin(), following.end(), 0);
+            for (size_t k = 0; k < n; k++) {
+                if (!active[k] || !atoms[k].accepts.test(c)) {
+                    continue;
+                }
+                char q = atoms[k].quantifier;
+                if (q == '*' || q == '+') {
+                    following[k] = 1;
+                }
+                following[k + 1] = 1;
+            }
+            if (!anchorStart) {
+                following[0] = 1;
+            }
+            Close(following);
+            active.swap(following);
+            if (Accepting(active, pos + 1 == text.size())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Atom {
+        std::bitset<256> accepts;
+        char quantifier = 0;    // 0, '*', '+' o '?'
+    };
+
+    // Los átomos opcionales (* ?) se pueden saltear sin consumir
+    void Close(std::vector<uint8_t>& states) const {
+        for (size_t k = 0; k < atoms.size(); k++) {
+            if (states[k] && (atoms[k].quantifier == '*' || atoms[k].quantifier == '?')) {
+                states[k + 1] = 1;
+            }
+        }
+    }
+
+    bool Accepting(const std::vector<uint8_t>& states, bool atEnd) const {
+        return states[atoms.size()] && (!anchorEnd || atEnd);
+    }
+
+    static void AddEscape(char c, std::bitset<256>& set) {
+        if (c == 'd' || c == 'w') {
+            for (int b = '0'; b <= '9'; b++) {
+                set.set(b);
+            }
+        }
+        if (c == 'w') {
+            for (int b = 'a'; b <= 'z'; b++) {
+                set.set(b);
+                set.set(b - 'a' + 'A');
+            }
+            set.set('_');
+        } else if (c == 's') {
+            set.set(' ');
+            set.set('\t');
+        } else if (c != 'd') {
+            set.set(static_cast<unsigned char>(c));
+        }
+    }
+
+    // [abc], [a-z], [^...]; i queda después del ']'
+    static bool ParseClass(const std::string& p, size_t& i, std::bitset<256>& set) {
+        i++;
+        bool negate = i < p.size() && p[i] == '^';
+        if (negate) {
+            i++;
+        }
+        bool first = true;
+        while (i < p.size() && (p[i] != ']' || first)) {
+            first = false;
+            unsigned char lo = p[i];
+            if (lo == '\\' && i + 1 < p.size()) {
+                AddEscape(p[i + 1], set);
+                i += 2;
+                continue;
+            }
+            if (i + 2 < p.size() && p[i + 1] == '-' && p[i + 2] != ']') {
+                unsigned char hi = p[i + 2];
+                for (int b = lo; b <= hi; b++) {
+                    set.set(b);
+                }
+                i += 3;
+            } else {
+                set.set(lo);
+                i++;
+            }
+        }
+        if (i >= p.size()) {
+            return false;   // falta el ']'
+        }
+        i++;
+        if (negate) {
+            set.flip();
+        }
+        return true;
+    }
+
+    std::vector<Atom> atoms;
+    bool anchorStart = false;
+    bool anchorEnd = false;
+};
+
+// Nombre demangled sin argumentos de template (A<B<int>>::f -> A::f). Los
+// operadores se dejan como están: operator< y operator<< no son templates
+inline std::string StripTemplateArgs(const std::string& name) {
+    if (name.find('<') == std::string::npos || name.find("operator") != std::string::npos) {
+        return name;
+    }
+    std::string stripped;
+    int depth = 0;
+    for (char c : name) {
+        if (c == '<') {
+            depth++;
+        } else if (c == '>' && depth > 0) {
+            depth--;
+        } else if (depth == 0) {
+            stripped += c;
+        }
+    }
+    return stripped;
+}
+
+class FunctionFilter {
+public:
+    // Incluir funciones cuyo nombre contiene el patrón (o es igual a él)
+    void AddPattern(const std::string& pattern) {
+        includes.Add(pattern);
+        empty = empty && pattern.empty();
+    }
+
+    // Incluir funciones que encajan con la expresión; false si es inválida
+    bool AddRegex(const std::string& pattern) {
+        NameRegex regex;
+        if (!regex.Compile(pattern)) {
+            return false;
+        }
+        regexes.push_back(regex);
+        empty = false;
+        return true;
+    }
+
+    // Descartar funciones cuyo nombre contiene el patrón, aunque se incluyan
+    void AddExclude(const std::string& pattern) {
+        excludes.Add(pattern);
+        empty = empty && pattern.empty();
+    }
+
+    // Construir los autómatas. Llamar una vez, después del último Add*
+    void Compile() {
+        includes.Compile();
+        excludes.Compile();
+    }
+
+    bool Empty() const {
+        return empty;
+    }
+
+    // Verificar si una función está en el conjunto de interés
+    bool Matches(const std::string& funcName) const {
+        return Matches(funcName, funcName);
+    }
+
+    bool Matches(const std::string& mangled, const std::string& demangled) const {
+        if (empty) {
+            return true; // Sin filtro, todas las funciones son de interés
+        }
+
+        std::string stripped = StripTemplateArgs(demangled);
+        const std::string* names[] = {&mangled, &demangled, &stripped};
+        size_t numNames = demangled == mangled ? 1 : (stripped == demangled ? 2 : 3);
+
+        bool included = includes.Empty() && regexes.empty();
+        for (size_t i = 0; i < numNames; i++) {
+            if (excludes.Search(*names[i])) {
+                return false;
+            }
+            if (!included) {
+                included = includes.Search(*names[i]) || MatchesRegex(*names[i]);
+            }
+        }
+        return included;
+    }
+
+private:
+    bool MatchesRegex(const std::string& name) const {
+        for (const NameRegex& regex : regexes) {
+            if (regex.Search(name)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    SubstringAutomaton includes;
+    SubstringAutomaton excludes;
+    std::vector<NameRegex> regexes;
+    bool empty = true;
+};
+
+#endif // CRYPTO_INJECTOR_FUNCTION_FILTER_H
@@ -0,0 +1,117 @@
+#ifndef CRYPTO_INJECTOR_IP_PROFILE_H
+#define CRYPTO_INJECTOR_IP_PROFILE_H
+
+// Perfil dinámico por dirección de instrucción (-ip_profile de inst_counter).
+//
+// Formato binario (little endian, sin padding entre campos de cabecera):
+//   "CIIPPROF" | uint32 versión | uint32 imágenes | uint64 registros
+//   por imagen: uint32 largo + nombre (sin '\0')
+//   registros:  IpProfileRecord[] tal cual están en memoria
+//
+// Las direcciones se guardan como desplazamiento desde IMG_LowAddress de su
+// imagen, así el perfil sirve aunque la imagen cargue en otra dirección.
+// No depende de Pin: lo leen también el inyector y run_campaign.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+const char IP_PROFILE_MAGIC[8] = {'C', 'I', 'I', 'P', 'P', 'R', 'O', 'F'};
+const uint32_t IP_PROFILE_VERSION = 2;
+
+// Destinos que el inyector puede corromper en la instrucción (máscara en
+// IpProfileRecord::destinations): run_campaign solo sortea los sitios que
+// sirven para su --target
+enum IpDestination : uint16_t {
+    IP_DEST_REG = 1,      // registro destino, explícito o implícito
+    IP_DEST_MEM = 2       // escritura a memoria
+};
+
+struct IpProfileRecord {
+    uint64_t offset;      // desde IMG_LowAddress
+    uint64_t count;       // ejecuciones dinámicas
+    uint32_t image;       // índice en IpProfile::images
+    uint16_t arithType;   // ArithType
+    uint16_t destinations;
+};
+static_assert(sizeof(IpProfileRecord) == 24, "IpProfileRecord debe ser compacto");
+
+struct IpProfile {
+    std::vector<std::string> images;
+    std::vector<IpProfileRecord> records;
+};
+
+inline bool WriteIpProfile(const std::string& path, const IpProfile& profile) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (f == nullptr) {
+        return false;
+    }
+
+    uint32_t version = IP_PROFILE_VERSION;
+    uint32_t numImages = static_cast<uint32_t>(profile.images.size());
+    uint64_t numRecords = profile.records.size();
+    bool ok = std::fwrite(IP_PROFILE_MAGIC, sizeof(IP_PROFILE_MAGIC), 1, f) == 1 &&
+              std::fwrite(&version, sizeof(version), 1, f) == 1 &&
+              std::fwrite(&numImages, sizeof(numImages), 1, f) == 1 &&
+              std::fwrite(&numRecords, sizeof(numRecords), 1, f) == 1;
+
+    for (const std::string& name : profile.images) {
+        uint32_t len = static_cast<uint32_t>(name.size());
+        ok = ok && std::fwrite(&len, sizeof(len), 1, f) == 1 &&
+             std::fwrite(name.data(), 1, len, f) == len;
+    }
+    if (numRecords > 0) {
+        ok = ok && std::fwrite(profile.records.data(), sizeof(IpProfileRecord),
+                               numRecords, f) == numRecords;
+    }
+
+    return std::fclose(f) == 0 && ok;
+}
+
+inline bool ReadIpProfile(const std::string& path, IpProfile& profile) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (f == nullptr) {
+        return false;
+    }
+
+    char magic[sizeof(IP_PROFILE_MAGIC)];
+    uint32_t version = 0;
+    uint32_t numImages = 0;
+    uint64_t numRecords = 0;
+    bool ok = std::fread(magic, sizeof(magic), 1, f) == 1 &&
+              std::string(magic, sizeof(magic)) == std::string(IP_PROFILE_MAGIC, sizeof(magic)) &&
+              std::fread(&version, sizeof(version), 1, f) == 1 &&
+              version == IP_PROFILE_VERSION &&
+              std::fread(&numImages, sizeof(numImages), 1, f) == 1 &&
+              std::fread(&numRecords, sizeof(numRecords), 1, f) == 1;
+
+    profile.images.clear();
+    for (uint32_t i = 0; ok && i < numImages; i++) {
+        uint32_t len = 0;
+        ok = std::fread(&len, sizeof(len), 1, f) == 1;
+        std::string name(ok ? len : 0, '\0');
+        ok = ok && (len == 0 || std::fread(&name[0], 1, len, f) == len);
+        profile.images.push_back(name);
+    }
+
+    // No confiar en la cabecera antes de reservar: un archivo truncado o
+    // dañado pediría una reserva enorme
+    long recordsStart = ok ? std::ftell(f) : -1;
+    ok = ok && recordsStart >= 0 && std::fseek(f, 0, SEEK_END) == 0;
+    long fileEnd = ok ? std::ftell(f) : -1;
+    ok = ok && fileEnd >= recordsStart &&
+         numRecords <= static_cast<uint64_t>(fileEnd - recordsStart) / sizeof(IpProfileRecord) &&
+         std::fseek(f, recordsStart, SEEK_SET) == 0;
+
+    profile.records.assign(ok ? numRecords : 0, IpProfileRecord());
+    if (ok && numRecords > 0) {
+        ok = std::fread(profile.records.data(), sizeof(IpProfileRecord),
+                        numRecords, f) == numRecords;
+    }
+
+    std::fclose(f);
+    return ok;
+}
+
+#endif // CRYPTO_INJECTOR_IP_PROFILE_H
@@ -0,0 +1,58 @@
+#ifndef CRYPTO_INJECTOR_LIVE_STATS_H
+#define CRYPTO_INJECTOR_LIVE_STATS_H
+
+// Contadores en vivo de inst_counter (-live) y su lector statview.
+//
+// Los arreglos de slots de cada thread viven en un archivo mapeado con
+// MAP_SHARED en lugar de memoria anónima: el análisis sigue siendo un
+// incremento sobre la base que llega en el registro de herramienta, y las
+// páginas quedan en el page cache aunque el proceso muera por SIGKILL.
+//
+// Archivo <live> (little endian):
+//   LiveStatsHeader, relleno hasta LIVE_STATS_DATA_OFFSET
+//   maxThreads arreglos de maxSlots uint64 (uno por thread, en orden de alta)
+// El archivo es disperso: solo ocupan disco las páginas tocadas.
+//
+// Archivo <live>.meta, texto, una línea por registro escrita con un solo
+// write() al instrumentar (el nombre va último porque puede tener espacios):
+//   T <tipo> <nombre>                      nombres de ArithType
+//   F <id> <primer slot> <nombre>          función: un slot por ArithType
+//   B <slot> <función> <c0> ... <cN-1>     bloque (-bbl): ejecuciones x histograma
+//   S <slot> <función> <tipo>              instrucción con slot propio (-ip_profile)
+// No depende de Pin.
+
+#include <cstdint>
+
+const char LIVE_STATS_MAGIC[8] = {'C', 'I', 'L', 'I', 'V', 'E', 'S', 'T'};
+const uint32_t LIVE_STATS_VERSION = 1;
+const uint64_t LIVE_STATS_DATA_OFFSET = 4096;
+
+enum LiveStatsState {
+    LIVE_RUNNING = 1,
+    LIVE_FINISHED = 2
+};
+
+// numThreads, numSlots y state cambian durante la corrida
+struct LiveStatsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t maxThreads;
+    uint32_t maxSlots;
+    volatile uint32_t numThreads;
+    volatile uint32_t numSlots;
+    volatile uint32_t state;
+    uint32_t pid;
+    int32_t exitCode;
+    double sampleMeanGap;       // -sample bbl: los conteos crudos se escalan por esto
+};
+
+inline uint64_t LiveStatsFileSize(uint32_t maxThreads, uint32_t maxSlots) {
+    return LIVE_STATS_DATA_OFFSET + static_cast<uint64_t>(maxThreads) * maxSlots * sizeof(uint64_t);
+}
+
+inline uint64_t* LiveThreadCounters(void* base, const LiveStatsHeader* header, uint32_t thread) {
+    return reinterpret_cast<uint64_t*>(static_cast<char*>(base) + LIVE_STATS_DATA_OFFSET) +
+           static_cast<uint64_t>(thread) * header->maxSlots;
+}
+
+#endif // CRYPTO_INJECTOR_LIVE_STATS_H
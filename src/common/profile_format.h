@@ -0,0 +1,676 @@
+#ifndef CRYPTO_INJECTOR_PROFILE_FORMAT_H
+#define CRYPTO_INJECTOR_PROFILE_FORMAT_H
+
+// Perfil de inst_counter en formato estructurado (-format bin|json|csv) y
+// su lector (profconv, herramientas de campaña).
+//
+// El perfil son tablas planas que se emiten en streaming a un ProfileSink,
+// sin copias ordenadas intermedias:
+//   types           tipo, nombre, conteo global
+//   functions       id, nombre, dirección, total, cota IC 95% (muestreo)
+//   function_types  función, tipo, conteo (solo los distintos de cero)
+//   images          id, nombre (imágenes del perfil por IP)
+//   ips             imagen, offset, tipo, función, conteo (-ip_profile)
+//   contexts        id, padre, función, profundidad, conteo exclusivo (-track 1)
+//   icalls          sitio, destino, función llamadora, conteo, nombre del destino (-icall 1)
+// Los ids de función son FunctionStats::id (índice en la tabla functions) y
+// los padres de un contexto siempre tienen id menor que sus hijos.
+//
+// Binario (little endian, registros tal cual en memoria):
+//   ProfileHeader
+//   por tabla: ProfileTableHeader + rows * recordSize bytes
+//   tabla PROFILE_STRINGS al final: nombres '\0' terminados
+// Los nombres se guardan como offset en la tabla de strings. recordSize
+// permite agregar campos al final de un registro y los lectores saltean
+// las tablas que no conocen.
+// El lector mapea el archivo y accede a cada tabla sin copiarla.
+// No depende de Pin.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char PROFILE_MAGIC[8] = {'C', 'I', 'P', 'R', 'O', 'F', 'I', 'L'};
+const uint32_t PROFILE_VERSION = 1;
+
+enum ProfileTable {
+    PROFILE_TYPES = 1,
+    PROFILE_FUNCTIONS,
+    PROFILE_FUNCTION_TYPES,
+    PROFILE_IMAGES,
+    PROFILE_IPS,
+    PROFILE_CONTEXTS,
+    PROFILE_STRINGS,
+    PROFILE_ICALLS,
+    PROFILE_NUM_TABLES
+};
+
+// Modo de muestreo con el que se obtuvieron los conteos
+enum ProfileSampling {
+    PROFILE_EXACT = 0,
+    PROFILE_SAMPLE_BBL = 1,
+    PROFILE_SAMPLE_SLICE = 2
+};
+
+struct ProfileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numTables;             // sin contar PROFILE_STRINGS
+    uint32_t numTypes;
+    uint32_t sampling;              // ProfileSampling
+    uint64_t total;                 // instrucciones aritméticas (estimadas si hubo muestreo)
+    double sampleScale;
+    double globalBound;             // semiancho del IC 95% del total
+    uint64_t filteredPointerSites;
+    uint64_t filteredLoopCounterSites;
+};
+
+struct ProfileTableHeader {
+    uint32_t table;                 // ProfileTable
+    uint32_t recordSize;
+    uint64_t rows;
+};
+
+struct ProfileTypeRecord {
+    uint32_t type;                  // ArithType
+    uint32_t name;
+    uint64_t count;
+};
+
+struct ProfileFunctionRecord {
+    uint64_t address;
+    uint64_t total;
+    double bound;
+    uint32_t id;
+    uint32_t name;
+};
+
+struct ProfileFunctionTypeRecord {
+    uint32_t function;
+    uint32_t type;
+    uint64_t count;
+};
+
+struct ProfileImageRecord {
+    uint32_t id;
+    uint32_t name;
+};
+
+struct ProfileIpRecord {
+    uint64_t offset;                // desde IMG_LowAddress, como en ip_profile.h
+    uint64_t count;
+    uint32_t image;
+    uint32_t type;
+    uint32_t function;
+    uint32_t reserved;
+};
+
+struct ProfileContextRecord {
+    uint32_t id;
+    uint32_t parent;
+    uint32_t function;
+    uint32_t depth;
+    uint64_t count;
+};
+
+struct ProfileIcallRecord {
+    uint64_t site;                  // dirección de la llamada
+    uint64_t target;
+    uint64_t count;
+    uint32_t caller;                // id de función
+    uint32_t name;                  // rutina destino
+};
+
+static_assert(sizeof(ProfileHeader) == 64, "ProfileHeader debe ser compacto");
+static_assert(sizeof(ProfileTableHeader) == 16, "ProfileTableHeader debe ser compacto");
+static_assert(sizeof(ProfileTypeRecord) == 16, "ProfileTypeRecord debe ser compacto");
+static_assert(sizeof(ProfileFunctionRecord) == 32, "ProfileFunctionRecord debe ser compacto");
+static_assert(sizeof(ProfileFunctionTypeRecord) == 16, "ProfileFunctionTypeRecord debe ser compacto");
+static_assert(sizeof(ProfileImageRecord) == 8, "ProfileImageRecord debe ser compacto");
+static_assert(sizeof(ProfileIpRecord) == 32, "ProfileIpRecord debe ser compacto");
+static_assert(sizeof(ProfileContextRecord) == 24, "ProfileContextRecord debe ser compacto");
+static_assert(sizeof(ProfileIcallRecord) == 32, "ProfileIcallRecord debe ser compacto");
+
+// Tamaño de registro que escribe esta versión de cada tabla (1 para la
+// tabla de strings, 0 para ids desconocidos)
+inline uint32_t ProfileRecordSize(uint32_t table) {
+    static const uint32_t sizes[] = {
+        0, sizeof(ProfileTypeRecord), sizeof(ProfileFunctionRecord),
+        sizeof(ProfileFunctionTypeRecord), sizeof(ProfileImageRecord),
+        sizeof(ProfileIpRecord), sizeof(ProfileContextRecord), 1,
+        sizeof(ProfileIcallRecord)
+    };
+    static_assert(sizeof(sizes) / sizeof(sizes[0]) == PROFILE_NUM_TABLES,
+                  "ProfileRecordSize debe cubrir cada ProfileTable");
+    return table < PROFILE_NUM_TABLES ? sizes[table] : 0;
+}
+
+// ============================================================================
+// ESCRITURA
+// ============================================================================
+
+// Destino del perfil. Las tablas se abren con BeginTable, reciben sus filas
+// y se cierran con EndTable; los nombres llegan como string y cada formato
+// decide cómo guardarlos (los campos name de los registros se ignoran)
+class ProfileSink {
+public:
+    virtual ~ProfileSink() {}
+    virtual void Begin(const ProfileHeader& summary) = 0;
+    virtual void BeginTable(ProfileTable table) = 0;
+    virtual void Type(uint32_t type, const std::string& name, uint64_t count) = 0;
+    virtual void Function(const ProfileFunctionRecord& r, const std::string& name) = 0;
+    virtual void FunctionType(const ProfileFunctionTypeRecord& r) = 0;
+    virtual void Image(uint32_t id, const std::string& name) = 0;
+    virtual void Ip(const ProfileIpRecord& r) = 0;
+    virtual void Context(const ProfileContextRecord& r) = 0;
+    virtual void Icall(const ProfileIcallRecord& r, const std::string& name) = 0;
+    virtual void EndTable() = 0;
+    virtual bool End() = 0;     // false si hubo un error de escritura
+};
+
+// Binario: la cantidad de filas de cada tabla se corrige al cerrarla, así
+// no hace falta contarlas antes (el archivo tiene que admitir fseek)
+class BinaryProfileSink : public ProfileSink {
+public:
+    explicit BinaryProfileSink(FILE* out) : out(out) {}
+
+    void Begin(const ProfileHeader& summary) override {
+        header = summary;
+        std::memcpy(header.magic, PROFILE_MAGIC, sizeof(header.magic));
+        header.version = PROFILE_VERSION;
+        header.numTables = 0;
+        Write(&header, sizeof(header));
+    }
+
+    void BeginTable(ProfileTable table) override {
+        current.table = table;
+        current.recordSize = ProfileRecordSize(table);
+        current.rows = 0;
+        currentOffset = std::ftell(out);
+        Write(&current, sizeof(current));
+    }
+
+    void Type(uint32_t type, const std::string& name, uint64_t count) override {
+        ProfileTypeRecord r = {};
+        r.type = type;
+        r.name = Intern(name);
+        r.count = count;
+        Row(&r, sizeof(r));
+    }
+
+    void Function(const ProfileFunctionRecord& r, const std::string& name) override {
+        ProfileFunctionRecord copy = r;
+        copy.name = Intern(name);
+        Row(&copy, sizeof(copy));
+    }
+
+    void FunctionType(const ProfileFunctionTypeRecord& r) override {
+        Row(&r, sizeof(r));
+    }
+
+    void Image(uint32_t id, const std::string& name) override {
+        ProfileImageRecord r = {};
+        r.id = id;
+        r.name = Intern(name);
+        Row(&r, sizeof(r));
+    }
+
+    void Ip(const ProfileIpRecord& r) override {
+        Row(&r, sizeof(r));
+    }
+
+    void Context(const ProfileContextRecord& r) override {
+        Row(&r, sizeof(r));
+    }
+
+    void Icall(const ProfileIcallRecord& r, const std::string& name) override {
+        ProfileIcallRecord copy = r;
+        copy.name = Intern(name);
+        Row(&copy, sizeof(copy));
+    }
+
+    void EndTable() override {
+        long end = std::ftell(out);
+        ok = ok && std::fseek(out, currentOffset, SEEK_SET) == 0;
+        Write(&current, sizeof(current));
+        ok = ok && std::fseek(out, end, SEEK_SET) == 0;
+        header.numTables++;
+    }
+
+    bool End() override {
+        ProfileTableHeader table = {PROFILE_STRINGS, 1, strings.size()};
+        Write(&table, sizeof(table));
+        Write(strings.data(), strings.size());
+        ok = ok && std::fseek(out, 0, SEEK_SET) == 0;
+        Write(&header, sizeof(header));
+        return ok && std::fflush(out) == 0;
+    }
+
+private:
+    void Write(const void* data, size_t size) {
+        ok = ok && (size == 0 || std::fwrite(data, size, 1, out) == 1);
+    }
+
+    void Row(const void* data, size_t size) {
+        Write(data, size);
+        current.rows++;
+    }
+
+    uint32_t Intern(const std::string& name) {
+        uint32_t offset = static_cast<uint32_t>(strings.size());
+        strings.append(name);
+        strings.push_back('\0');
+        return offset;
+    }
+
+    FILE* out;
+    bool ok = true;
+    ProfileHeader header = {};
+    ProfileTableHeader current = {};
+    long currentOffset = 0;
+    std::string strings;
+};
+
+// Escape de strings JSON (los nombres demangled traen comillas en literales)
+inline void WriteJsonString(FILE* out, const std::string& s) {
+    std::fputc('"', out);
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', out);
+            std::fputc(c, out);
+        } else if (c < 0x20) {
+            std::fprintf(out, "\\u%04x", c);
+        } else {
+            std::fputc(c, out);
+        }
+    }
+    std::fputc('"', out);
+}
+
+// JSON: un objeto con "summary" y un arreglo de objetos por tabla
+class JsonProfileSink : public ProfileSink {
+public:
+    explicit JsonProfileSink(FILE* out) : out(out) {}
+
+    void Begin(const ProfileHeader& s) override {
+        std::fprintf(out, "{\"version\":%u,\"summary\":{\"types\":%u,\"sampling\":\"%s\","
+                     "\"total\":%llu,\"sample_scale\":%.17g,\"global_bound\":%.17g,"
+                     "\"filtered_pointer_sites\":%llu,\"filtered_loop_counter_sites\":%llu}",
+                     PROFILE_VERSION, s.numTypes, SamplingName(s.sampling),
+                     static_cast<unsigned long long>(s.total), s.sampleScale, s.globalBound,
+                     static_cast<unsigned long long>(s.filteredPointerSites),
+                     static_cast<unsigned long long>(s.filteredLoopCounterSites));
+    }
+
+    void BeginTable(ProfileTable table) override {
+        static const char* const names[] = {
+            "", "types", "functions", "function_types", "images", "ips", "contexts", "strings",
+            "icalls"
+        };
+        std::fprintf(out, ",\n\"%s\":[", names[table]);
+        first = true;
+    }
+
+    void Type(uint32_t type, const std::string& name, uint64_t count) override {
+        if (typeNames.size() <= type) {
+            typeNames.resize(type + 1);
+        }
+        typeNames[type] = name;
+        Separator();
+        std::fprintf(out, "{\"type\":");
+        WriteJsonString(out, name);
+        std::fprintf(out, ",\"count\":%llu}", static_cast<unsigned long long>(count));
+    }
+
+    void Function(const ProfileFunctionRecord& r, const std::string& name) override {
+        Separator();
+        std::fprintf(out, "{\"id\":%u,\"name\":", r.id);
+        WriteJsonString(out, name);
+        std::fprintf(out, ",\"address\":\"0x%llx\",\"total\":%llu,\"bound\":%.17g}",
+                     static_cast<unsigned long long>(r.address),
+                     static_cast<unsigned long long>(r.total), r.bound);
+    }
+
+    void FunctionType(const ProfileFunctionTypeRecord& r) override {
+        Separator();
+        std::fprintf(out, "{\"function\":%u,\"type\":", r.function);
+        WriteJsonString(out, TypeName(r.type));
+        std::fprintf(out, ",\"count\":%llu}", static_cast<unsigned long long>(r.count));
+    }
+
+    void Image(uint32_t id, const std::string& name) override {
+        Separator();
+        std::fprintf(out, "{\"id\":%u,\"name\":", id);
+        WriteJsonString(out, name);
+        std::fputc('}', out);
+    }
+
+    void Ip(const ProfileIpRecord& r) override {
+        Separator();
+        std::fprintf(out, "{\"image\":%u,\"offset\":\"0x%llx\",\"type\":", r.image,
+                     static_cast<unsigned long long>(r.offset));
+        WriteJsonString(out, TypeName(r.type));
+        std::fprintf(out, ",\"function\":%u,\"count\":%llu}", r.function,
+                     static_cast<unsigned long long>(r.count));
+    }
+
+    void Context(const ProfileContextRecord& r) override {
+        Separator();
+        std::fprintf(out, "{\"id\":%u,\"parent\":%u,\"function\":%u,\"depth\":%u,\"count\":%llu}",
+                     r.id, r.parent, r.function, r.depth, static_cast<unsigned long long>(r.count));
+    }
+
+    void Icall(const ProfileIcallRecord& r, const std::string& name) override {
+        Separator();
+        std::fprintf(out, "{\"site\":\"0x%llx\",\"target\":\"0x%llx\",\"caller\":%u,\"count\":%llu,\"name\":",
+                     static_cast<unsigned long long>(r.site), static_cast<unsigned long long>(r.target),
+                     r.caller, static_cast<unsigned long long>(r.count));
+        WriteJsonString(out, name);
+        std::fputc('}', out);
+    }
+
+    void EndTable() override {
+        std::fputc(']', out);
+    }
+
+    bool End() override {
+        std::fprintf(out, "}\n");
+        return std::fflush(out) == 0 && !std::ferror(out);
+    }
+
+    static const char* SamplingName(uint32_t sampling) {
+        return sampling == PROFILE_SAMPLE_BBL ? "bbl" :
+               sampling == PROFILE_SAMPLE_SLICE ? "slice" : "exact";
+    }
+
+private:
+    void Separator() {
+        std::fputs(first ? "\n" : ",\n", out);
+        first = false;
+    }
+
+    std::string TypeName(uint32_t type) const {
+        return type < typeNames.size() ? typeNames[type] : std::to_string(type);
+    }
+
+    FILE* out;
+    bool first = true;
+    std::vector<std::string> typeNames;
+};
+
+// CSV en formato largo: una fila por registro de cualquier tabla, con la
+// columna table para filtrar. Las columnas que no aplican quedan vacías.
+// El resumen va como filas de la tabla summary (name = clave, count = valor)
+class CsvProfileSink : public ProfileSink {
+public:
+    explicit CsvProfileSink(FILE* out) : out(out) {}
+
+    void Begin(const ProfileHeader& s) override {
+        std::fprintf(out, "table,id,parent,function,type,image,address,depth,count,bound,name\n");
+        std::fprintf(out, "summary,,,,,,,,%u,,version\n", PROFILE_VERSION);
+        std::fprintf(out, "summary,,,,,,,,%llu,%.17g,total\n",
+                     static_cast<unsigned long long>(s.total), s.globalBound);
+        std::fprintf(out, "summary,,,,,,,,%.17g,,sample_scale\n", s.sampleScale);
+        std::fprintf(out, "summary,,,,,,,,%u,,sampling_%s\n", s.sampling,
+                     JsonProfileSink::SamplingName(s.sampling));
+        std::fprintf(out, "summary,,,,,,,,%llu,,filtered_pointer_sites\n",
+                     static_cast<unsigned long long>(s.filteredPointerSites));
+        std::fprintf(out, "summary,,,,,,,,%llu,,filtered_loop_counter_sites\n",
+                     static_cast<unsigned long long>(s.filteredLoopCounterSites));
+    }
+
+    void BeginTable(ProfileTable) override {}
+
+    void Type(uint32_t type, const std::string& name, uint64_t count) override {
+        if (typeNames.size() <= type) {
+            typeNames.resize(type + 1);
+        }
+        typeNames[type] = name;
+        std::fprintf(out, "type,%u,,,%s,,,,%llu,,\n", type, name.c_str(),
+                     static_cast<unsigned long long>(count));
+    }
+
+    void Function(const ProfileFunctionRecord& r, const std::string& name) override {
+        std::fprintf(out, "function,%u,,,,,0x%llx,,%llu,%.17g,", r.id,
+                     static_cast<unsigned long long>(r.address),
+                     static_cast<unsigned long long>(r.total), r.bound);
+        WriteQuoted(name);
+    }
+
+    void FunctionType(const ProfileFunctionTypeRecord& r) override {
+        std::fprintf(out, "function_type,,,%u,%s,,,,%llu,,\n", r.function, TypeName(r.type).c_str(),
+                     static_cast<unsigned long long>(r.count));
+    }
+
+    void Image(uint32_t id, const std::string& name) override {
+        std::fprintf(out, "image,%u,,,,,,,,,", id);
+        WriteQuoted(name);
+    }
+
+    void Ip(const ProfileIpRecord& r) override {
+        std::fprintf(out, "ip,,,%u,%s,%u,0x%llx,,%llu,,\n", r.function, TypeName(r.type).c_str(),
+                     r.image, static_cast<unsigned long long>(r.offset),
+                     static_cast<unsigned long long>(r.count));
+    }
+
+    void Context(const ProfileContextRecord& r) override {
+        std::fprintf(out, "context,%u,%u,%u,,,,%u,%llu,,\n", r.id, r.parent, r.function, r.depth,
+                     static_cast<unsigned long long>(r.count));
+    }
+
+    // id = dirección del sitio, address = destino
+    void Icall(const ProfileIcallRecord& r, const std::string& name) override {
+        std::fprintf(out, "icall,0x%llx,,%u,,,0x%llx,,%llu,,",
+                     static_cast<unsigned long long>(r.site), r.caller,
+                     static_cast<unsigned long long>(r.target),
+                     static_cast<unsigned long long>(r.count));
+        WriteQuoted(name);
+    }
+
+    void EndTable() override {}
+
+    bool End() override {
+        return std::fflush(out) == 0 && !std::ferror(out);
+    }
+
+private:
+    // Los nombres C++ llevan comas: siempre entre comillas, "" para escapar
+    void WriteQuoted(const std::string& s) {
+        std::fputc('"', out);
+        for (char c : s) {
+            if (c == '"') {
+                std::fputc('"', out);
+            }
+            std::fputc(c, out);
+        }
+        std::fputs("\"\n", out);
+    }
+
+    std::string TypeName(uint32_t type) const {
+        return type < typeNames.size() ? typeNames[type] : std::to_string(type);
+    }
+
+    FILE* out;
+    std::vector<std::string> typeNames;
+};
+
+// ============================================================================
+// LECTURA
+// ============================================================================
+
+// Vista de solo lectura sobre un perfil binario mapeado en memoria
+class ProfileView {
+public:
+    ProfileView() = default;
+    ProfileView(const ProfileView&) = delete;
+    ProfileView& operator=(const ProfileView&) = delete;
+
+    ~ProfileView() {
+        Close();
+    }
+
+    bool Open(const std::string& path) {
+        Close();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ProfileHeader)) {
+            close(fd);
+            return false;
+        }
+        void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (m == MAP_FAILED) {
+            return false;
+        }
+        map = m;
+        mapSize = st.st_size;
+
+        const char* base = static_cast<const char*>(map);
+        header = reinterpret_cast<const ProfileHeader*>(base);
+        if (std::memcmp(header->magic, PROFILE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != PROFILE_VERSION) {
+            Close();
+            return false;
+        }
+
+        // Recorrer las tablas validando que entren en el archivo. Una tabla
+        // conocida con registros más cortos que los de esta versión se
+        // rechaza: Row() devolvería nullptr en cada fila
+        uint64_t pos = sizeof(ProfileHeader);
+        for (uint32_t i = 0; i <= header->numTables; i++) {
+            if (pos + sizeof(ProfileTableHeader) > mapSize) {
+                Close();
+                return false;
+            }
+            const ProfileTableHeader* t = reinterpret_cast<const ProfileTableHeader*>(base + pos);
+            pos += sizeof(ProfileTableHeader);
+            if (t->recordSize == 0 || t->rows > (mapSize - pos) / t->recordSize ||
+                t->recordSize < ProfileRecordSize(t->table)) {
+                Close();
+                return false;
+            }
+            if (t->table >= PROFILE_TYPES && t->table < PROFILE_NUM_TABLES) {
+                tables[t->table] = t;
+            }
+            pos += t->rows * t->recordSize;
+        }
+
+        const ProfileTableHeader* s = tables[PROFILE_STRINGS];
+        if (s == nullptr || s->recordSize != 1 ||
+            (s->rows > 0 && Data(s)[s->rows - 1] != '\0')) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (map != nullptr) {
+            munmap(map, mapSize);
+        }
+        map = nullptr;
+        mapSize = 0;
+        header = nullptr;
+        for (const ProfileTableHeader*& t : tables) {
+            t = nullptr;
+        }
+    }
+
+    const ProfileHeader& Header() const { return *header; }
+
+    // Filas de una tabla (0 si no está en el perfil)
+    uint64_t Rows(ProfileTable table) const {
+        return tables[table] != nullptr ? tables[table]->rows : 0;
+    }
+
+    // Registro i de una tabla. Con recordSize mayor al conocido los campos
+    // nuevos se ignoran; menor no se acepta
+    template <typename Record>
+    const Record* Row(ProfileTable table, uint64_t i) const {
+        const ProfileTableHeader* t = tables[table];
+        if (t == nullptr || i >= t->rows || t->recordSize < sizeof(Record)) {
+            return nullptr;
+        }
+        return reinterpret_cast<const Record*>(Data(t) + i * t->recordSize);
+    }
+
+    const char* String(uint32_t offset) const {
+        const ProfileTableHeader* s = tables[PROFILE_STRINGS];
+        return offset < s->rows ? Data(s) + offset : "";
+    }
+
+private:
+    static const char* Data(const ProfileTableHeader* t) {
+        return reinterpret_cast<const char*>(t + 1);
+    }
+
+    void* map = nullptr;
+    size_t mapSize = 0;
+    const ProfileHeader* header = nullptr;
+    const ProfileTableHeader* tables[PROFILE_NUM_TABLES] = {};
+};
+
+// Reemitir un perfil binario a otro formato, tabla por tabla en el orden
+// del archivo original
+inline bool ReplayProfile(const ProfileView& view, ProfileSink& sink) {
+    sink.Begin(view.Header());
+    const ProfileTable order[] = {
+        PROFILE_TYPES, PROFILE_FUNCTIONS, PROFILE_FUNCTION_TYPES,
+        PROFILE_IMAGES, PROFILE_IPS, PROFILE_CONTEXTS, PROFILE_ICALLS
+    };
+    for (ProfileTable table : order) {
+        uint64_t rows = view.Rows(table);
+        if (rows == 0) {
+            continue;
+        }
+        sink.BeginTable(table);
+        for (uint64_t i = 0; i < rows; i++) {
+            switch (table) {
+                case PROFILE_TYPES: {
+                    const ProfileTypeRecord* r = view.Row<ProfileTypeRecord>(table, i);
+                    sink.Type(r->type, view.String(r->name), r->count);
+                    break;
+                }
+                case PROFILE_FUNCTIONS: {
+                    const ProfileFunctionRecord* r = view.Row<ProfileFunctionRecord>(table, i);
+                    sink.Function(*r, view.String(r->name));
+                    break;
+                }
+                case PROFILE_FUNCTION_TYPES:
+                    sink.FunctionType(*view.Row<ProfileFunctionTypeRecord>(table, i));
+                    break;
+                case PROFILE_IMAGES: {
+                    const ProfileImageRecord* r = view.Row<ProfileImageRecord>(table, i);
+                    sink.Image(r->id, view.String(r->name));
+                    break;
+                }
+                case PROFILE_IPS:
+                    sink.Ip(*view.Row<ProfileIpRecord>(table, i));
+                    break;
+                case PROFILE_CONTEXTS:
+                    sink.Context(*view.Row<ProfileContextRecord>(table, i));
+                    break;
+                case PROFILE_ICALLS: {
+                    const ProfileIcallRecord* r = view.Row<ProfileIcallRecord>(table, i);
+                    sink.Icall(*r, view.String(r->name));
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        sink.EndTable();
+    }
+    return sink.End();
+}
+
+#endif // CRYPTO_INJECTOR_PROFILE_FORMAT_H
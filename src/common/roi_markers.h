@@ -0,0 +1,54 @@
+#ifndef CRYPTO_INJECTOR_ROI_MARKERS_H
+#define CRYPTO_INJECTOR_ROI_MARKERS_H
+
+// Marcadores de región de interés (ROI) para las pintools.
+//
+// El programa objetivo llama a CryptoInjectorRoiBegin()/CryptoInjectorRoiEnd()
+// alrededor de la parte que interesa medir (por ejemplo las llamadas a
+// Encrypt, dejando afuera GenCryptoContext y KeyGen). Las pintools buscan
+// estas rutinas por nombre y solo cuentan dentro de la región.
+//
+// Son funciones vacías que no se pueden inlinear ni eliminar: el asm volatile
+// evita que el compilador las trate como puras y borre la llamada. Fuera de
+// Pin su costo es una llamada y un ret.
+//
+// CryptoInjectorIterationBoundary(i) separa las repeticiones de un harness
+// que corre el mismo pipeline muchas veces en un solo proceso: el inyector
+// la usa para armar la falla de la iteración i sin relanzar la aplicación.
+//
+// CryptoInjectorRegisterBuffer(base, bytes) declara memoria de la aplicación
+// (p. ej. las limbs de un ciphertext) como blanco de FaultInjector -target
+// buffer; CryptoInjectorClearBuffers() olvida los registrados.
+
+#define CRYPTO_INJECTOR_ROI_BEGIN_NAME "CryptoInjectorRoiBegin"
+#define CRYPTO_INJECTOR_ROI_END_NAME   "CryptoInjectorRoiEnd"
+#define CRYPTO_INJECTOR_ITERATION_NAME "CryptoInjectorIterationBoundary"
+#define CRYPTO_INJECTOR_REGISTER_BUFFER_NAME "CryptoInjectorRegisterBuffer"
+#define CRYPTO_INJECTOR_CLEAR_BUFFERS_NAME   "CryptoInjectorClearBuffers"
+
+extern "C" {
+
+__attribute__((noinline, used)) inline void CryptoInjectorRoiBegin() {
+    __asm__ __volatile__("" ::: "memory");
+}
+
+__attribute__((noinline, used)) inline void CryptoInjectorRoiEnd() {
+    __asm__ __volatile__("" ::: "memory");
+}
+
+__attribute__((noinline, used)) inline void CryptoInjectorIterationBoundary(unsigned long long iteration) {
+    __asm__ __volatile__("" :: "r"(iteration) : "memory");
+}
+
+__attribute__((noinline, used)) inline void CryptoInjectorRegisterBuffer(const void* base,
+                                                                         unsigned long long bytes) {
+    __asm__ __volatile__("" :: "r"(base), "r"(bytes) : "memory");
+}
+
+__attribute__((noinline, used)) inline void CryptoInjectorClearBuffers() {
+    __asm__ __volatile__("" ::: "memory");
+}
+
+}
+
+#endif // CRYPTO_INJECTOR_ROI_MARKERS_H
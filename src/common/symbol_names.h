@@ -0,0 +1,35 @@
+#ifndef CRYPTO_INJECTOR_SYMBOL_NAMES_H
+#define CRYPTO_INJECTOR_SYMBOL_NAMES_H
+
+// Nombres demangled de rutinas para el filtro de funciones. RTN_Name
+// devuelve el nombre mangled; PIN_UndecorateSymbolName es caro y una misma
+// rutina se consulta varias veces (filtro, marcadores, traces en -lazy),
+// así que el resultado se guarda por dirección de entrada.
+
+#include "pin.H"
+#include <string>
+#include <unordered_map>
+
+class SymbolNameCache {
+public:
+    // [scope::]nombre sin tipo de retorno ni parámetros (UNDECORATION_NAME_ONLY)
+    const std::string& Demangled(ADDRINT address, const std::string& mangled) {
+        auto known = names.find(address);
+        if (known != names.end()) {
+            return known->second;
+        }
+
+        std::string demangled = mangled;
+        #if defined(TARGET_LINUX) || defined(TARGET_MAC)
+        if (mangled.compare(0, 2, "_Z") == 0) {
+            demangled = PIN_UndecorateSymbolName(mangled, UNDECORATION_NAME_ONLY);
+        }
+        #endif
+        return names.emplace(address, demangled).first->second;
+    }
+
+private:
+    std::unordered_map<ADDRINT, std::string> names;
+};
+
+#endif // CRYPTO_INJECTOR_SYMBOL_NAMES_H
@@ -0,0 +1,1190 @@
+#include "pin.H"
+#include "roi_markers.h"
+#include "arith_classify.h"
+#include "function_filter.h"
+#include "symbol_names.h"
+#include "decision_cache.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <atomic>
+#include <cctype>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using std::string;
+using std::set;
+using std::deque;
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+// Dónde cae la falla (-target)
+enum InjectionTarget {
+    TARGET_REG,     // registro destino de la instrucción
+    TARGET_MEM,     // bytes que la instrucción escribe en memoria
+    TARGET_BUFFER   // buffers registrados (CryptoInjectorRegisterBuffer)
+};
+
+// Buffer registrado por la aplicación (p. ej. las limbs de un ciphertext)
+struct RegisteredBuffer {
+    ADDRINT base;
+    UINT64 bytes;
+};
+
+// Instrucción estática candidata a inyección (se pasa como IARG_PTR)
+struct InjectionSite {
+    ADDRINT address;
+    string routine;
+    string disassembly;
+    REG reg;
+    ArithType type;
+};
+
+// ============================================================================
+// VARIABLES GLOBALES
+// ============================================================================
+
+// Funciones de interés (filtros -f, -f_regex, -f_exclude) y nombres
+// demangled por dirección de rutina
+FunctionFilter functionFilter;
+SymbolNameCache symbolNames;
+
+// Opcodes (OPCODE_StringShort) o familias de ArithType seleccionados (-op)
+set<string> selectedOps;
+
+// Sitio único (-ip_image/-ip_offset, sorteado de un perfil por IP): solo se
+// instrumenta esa instrucción y -n cuenta sus ejecuciones
+bool singleSite = false;
+ADDRINT singleSiteAddress = 0;
+
+// Sitios elegidos al cargar cada imagen; deque para que los punteros sigan
+// siendo válidos. Las llamadas se insertan al compilar cada trace, así tras
+// la inyección PIN_RemoveInstrumentation las quita del código que sigue
+deque<InjectionSite> injectionSites;
+std::unordered_map<ADDRINT, const InjectionSite*> sitesByAddress;
+ADDRINT sitesLow = ~static_cast<ADDRINT>(0);
+ADDRINT sitesHigh = 0;
+
+// Instancias dinámicas restantes hasta la inyección. Lo decrementa el
+// predicado inline; en programas multihilo el conteo no es atómico
+volatile UINT64 remainingInstances = 1;
+UINT64 targetInstance = 1;
+UINT32 faultBit = 0;
+
+InjectionTarget injectionTarget = TARGET_REG;
+
+// -target mem: escritura de la instancia objetivo, capturada en IPOINT_BEFORE
+// y corrompida en IPOINT_AFTER (la dirección solo se conoce antes). Solo el
+// thread que la capturó la corrompe: en otro thread la escritura no ocurrió
+volatile ADDRINT pendingWriteEa = 0;
+UINT32 pendingWriteSize = 0;
+THREADID pendingWriteTid = INVALID_THREADID;
+
+// -target buffer: buffers registrados; -bit indexa sus bytes concatenados
+std::vector<RegisteredBuffer> registeredBuffers;
+PIN_LOCK buffersLock;
+
+// Evita una segunda inyección si varios threads llegan a la vez
+std::atomic<bool> injected(false);
+
+std::ofstream logFile;
+
+// Modo fork-server (-checkpoint): el proceso corre una vez hasta el punto
+// de control y ahí crea un hijo por falla. -n cuenta desde el checkpoint
+FunctionFilter checkpointFilter;
+bool forkServer = false;
+bool forkServerParent = false;
+UINT64 faultId = 0;
+
+// Hijo en vuelo del fork-server: su registro llega por un pipe propio y el
+// padre lo copia entero a -o cuando el hijo termina
+struct ForkChild {
+    UINT64 id;
+    int pipeFd;
+    double start;
+    bool killed;
+};
+
+// fork/waitpid/kill de la libc de la aplicación (se llaman con
+// PIN_CallApplicationFunction para que Pin siga al hijo)
+AFUNPTR appFork = nullptr;
+AFUNPTR appWaitpid = nullptr;
+AFUNPTR appKill = nullptr;
+
+// Modo por iteración (-per_iteration): un harness repite el pipeline en un
+// solo proceso y en cada CryptoInjectorIterationBoundary se arma la
+// siguiente falla leída de -params. -n cuenta desde el límite
+bool perIteration = false;
+bool iterationArmed = false;
+std::ifstream iterationParams;
+
+// Watchdog (-budget/-catch_signals): tras inyectar Pin sigue acoplado, cada
+// trace descuenta sus instrucciones del presupuesto y las señales fatales se
+// interceptan; la corrida termina en el acto con un registro outcome=
+bool watchdog = false;
+UINT64 instructionBudget = 0;
+volatile INT64 budgetRemaining = 0;
+volatile bool budgetArmed = false;
+
+// -count_ins (corrida dorada): instrucciones dinámicas totales
+bool countInstructions = false;
+UINT64 executedInstructions = 0;
+
+// Código de salida de una corrida cortada por el watchdog (como timeout(1))
+const INT32 HANG_EXIT_CODE = 124;
+
+// Cache de decisiones por imagen (-decision_cache); el hash cubre las
+// opciones que cambian qué se instrumenta
+string decisionCacheDir;
+UINT64 decisionOptionsHash = 0;
+
+// ============================================================================
+// CONFIGURACIÓN (KNOBS)
+// ============================================================================
+
+KNOB<string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool",
+    "o", "injection.log", "Archivo con el registro de la inyección");
+
+KNOB<string> KnobFunctionFilter(KNOB_MODE_APPEND, "pintool",
+    "f", "", "Inyectar solo en esta función (repetible)");
+
+KNOB<string> KnobFunctionRegex(KNOB_MODE_APPEND, "pintool",
+    "f_regex", "", "Inyectar solo en funciones que encajan con la expresión (repetible)");
+
+KNOB<string> KnobFunctionExclude(KNOB_MODE_APPEND, "pintool",
+    "f_exclude", "", "No inyectar en funciones cuyo nombre contiene esto (repetible)");
+
+KNOB<string> KnobOpcode(KNOB_MODE_APPEND, "pintool",
+    "op", "", "Opcode (ej: VPADDQ) o familia aritmética (ej: SIMD_MUL) (repetible)");
+
+KNOB<UINT64> KnobInstance(KNOB_MODE_WRITEONCE, "pintool",
+    "n", "1", "Instancia dinámica (1-based) en la que se inyecta");
+
+KNOB<UINT32> KnobBit(KNOB_MODE_WRITEONCE, "pintool",
+    "bit", "0", "Bit a invertir en el registro destino (módulo su ancho)");
+
+KNOB<string> KnobIpImage(KNOB_MODE_WRITEONCE, "pintool",
+    "ip_image", "", "Sitio único: imagen (nombre del perfil -ip_profile)");
+
+KNOB<UINT64> KnobIpOffset(KNOB_MODE_WRITEONCE, "pintool",
+    "ip_offset", "0", "Sitio único: desplazamiento desde el inicio de la imagen");
+
+KNOB<string> KnobTarget(KNOB_MODE_WRITEONCE, "pintool",
+    "target", "reg", "Destino de la falla: reg, mem (escritura de la instrucción) o buffer");
+
+KNOB<BOOL> KnobDetach(KNOB_MODE_WRITEONCE, "pintool",
+    "detach", "1", "Desacoplar Pin tras la inyección (resto de la ejecución nativa)");
+
+KNOB<string> KnobCheckpoint(KNOB_MODE_WRITEONCE, "pintool",
+    "checkpoint", "", "Rutina punto de control del modo fork-server");
+
+KNOB<string> KnobFaultParams(KNOB_MODE_WRITEONCE, "pintool",
+    "params", "fault_params.fifo", "Fork-server/por iteración: fallas '<n> <bit>', una por línea");
+
+KNOB<UINT32> KnobForkJobs(KNOB_MODE_WRITEONCE, "pintool",
+    "fork_jobs", "1", "Fork-server: hijos corriendo a la vez");
+
+KNOB<UINT32> KnobForkTimeout(KNOB_MODE_WRITEONCE, "pintool",
+    "fork_timeout", "0", "Fork-server: segundos antes de matar a un hijo (0: sin límite)");
+
+KNOB<string> KnobForkOutput(KNOB_MODE_WRITEONCE, "pintool",
+    "fork_output", "", "Fork-server: stdout de cada hijo a <prefijo><id>.out");
+
+KNOB<BOOL> KnobPerIteration(KNOB_MODE_WRITEONCE, "pintool",
+    "per_iteration", "0", "Una falla por iteración del harness (CryptoInjectorIterationBoundary)");
+
+KNOB<UINT64> KnobBudget(KNOB_MODE_WRITEONCE, "pintool",
+    "budget", "0", "Instrucciones permitidas tras la inyección antes de declarar hang (0: sin límite)");
+
+KNOB<BOOL> KnobCatchSignals(KNOB_MODE_WRITEONCE, "pintool",
+    "catch_signals", "0", "Interceptar señales fatales y registrar outcome=crash");
+
+KNOB<BOOL> KnobCountInstructions(KNOB_MODE_WRITEONCE, "pintool",
+    "count_ins", "0", "Contar instrucciones dinámicas (corrida dorada, para -budget)");
+
+KNOB<BOOL> KnobIncludeLibraries(KNOB_MODE_WRITEONCE, "pintool",
+    "l", "0", "Incluir bibliotecas dinámicas");
+
+KNOB<string> KnobDecisionCache(KNOB_MODE_WRITEONCE, "pintool",
+    "decision_cache", "", "Directorio del cache de decisiones de instrumentación por build-id");
+
+KNOB<BOOL> KnobVerbose(KNOB_MODE_WRITEONCE, "pintool",
+    "v", "0", "Modo verbose");
+
+// ============================================================================
+// FUNCIONES AUXILIARES
+// ============================================================================
+
+string ToUpper(string s) {
+    for (char& c : s) {
+        c = std::toupper(static_cast<unsigned char>(c));
+    }
+    return s;
+}
+
+// Una instrucción se selecciona por su opcode o por su familia aritmética.
+// Sin -op, toda instrucción aritmética es candidata
+bool IsSelectedInstruction(INS ins, ArithType type) {
+    if (selectedOps.empty()) {
+        return type != ARITH_UNKNOWN;
+    }
+    if (selectedOps.count(ToUpper(OPCODE_StringShort(INS_Opcode(ins))))) {
+        return true;
+    }
+    return type != ARITH_UNKNOWN && selectedOps.count(ArithTypeNames[type]);
+}
+
+// ============================================================================
+// FUNCIONES DE ANÁLISIS
+// ============================================================================
+
+// Predicado inline: verdadero solo en la instancia objetivo
+ADDRINT PIN_FAST_ANALYSIS_CALL CountdownToTarget() {
+    return --remainingInstances == 0;
+}
+
+// Comienzo común del registro de una inyección
+VOID LogInjection(const InjectionSite* site, THREADID tid) {
+    if (forkServer || perIteration) {
+        logFile << "id=" << faultId << " ";
+    }
+    logFile << "status=injected"
+            << " instance=" << targetInstance
+            << " tid=" << tid
+            << " ip=0x" << std::hex << site->address << std::dec
+            << " routine=" << site->routine
+            << " family=" << ArithTypeNames[site->type];
+}
+
+// Cerrar el registro y, salvo en modo por iteración, desacoplar: el resto
+// de la ejecución corre nativa, así el costo de cada corrida es casi todo
+// ejecución nativa y no instrumentación. Con watchdog se sigue acoplado:
+// los traces se recompilan sin los sitios (salvo por iteración, que arma
+// más fallas) y con un descuento del presupuesto por trace
+VOID FinishInjection(const InjectionSite* site) {
+    logFile << " ins=\"" << site->disassembly << "\"" << std::endl;
+
+    if (watchdog) {
+        bool recompile = !perIteration;
+        if (instructionBudget > 0 && !budgetArmed) {
+            budgetRemaining = static_cast<INT64>(instructionBudget);
+            budgetArmed = true;
+            recompile = true;
+        }
+        if (recompile) {
+            PIN_RemoveInstrumentation();
+        }
+        return;
+    }
+    if (KnobDetach.Value() && !perIteration) {
+        PIN_Detach();
+    }
+}
+
+// Prefijo de id y registro final de la corrida (una línea)
+VOID LogOutcome(const char* outcome) {
+    if (forkServer || perIteration) {
+        logFile << "id=" << faultId << " ";
+    }
+    logFile << "outcome=" << outcome;
+}
+
+// Descuento del presupuesto por trace (condición inline)
+ADDRINT PIN_FAST_ANALYSIS_CALL ConsumeBudget(UINT32 instructions) {
+    budgetRemaining -= instructions;
+    return budgetRemaining <= 0;
+}
+
+// Presupuesto agotado: la falla dejó a la aplicación en un loop
+VOID BudgetExhausted(ADDRINT ip, THREADID tid) {
+    LogOutcome("hang");
+    logFile << " budget=" << instructionBudget
+            << " tid=" << tid
+            << " ip=0x" << std::hex << ip << std::dec << std::endl;
+    logFile.close();
+    PIN_ExitProcess(HANG_EXIT_CODE);
+}
+
+VOID PIN_FAST_ANALYSIS_CALL CountInstructions(UINT32 instructions) {
+    executedInstructions += instructions;
+}
+
+// Señal fatal: si la aplicación no tiene su propio handler, registrar el
+// crash y terminar sin pasar por el handler por defecto (ni core dump)
+BOOL InterceptFatalSignal(THREADID tid, INT32 sig, CONTEXT* ctxt, BOOL hasHandler,
+                          const EXCEPTION_INFO* exception, VOID* v) {
+    if (hasHandler) {
+        return TRUE;
+    }
+    LogOutcome("crash");
+    logFile << " signal=" << sig
+            << " injected=" << (injected.load() ? 1 : 0)
+            << " tid=" << tid
+            << " ip=0x" << std::hex << PIN_GetContextReg(ctxt, REG_INST_PTR) << std::dec;
+    if (exception != nullptr) {
+        logFile << " exception=\"" << PIN_ExceptionToString(exception) << "\"";
+    }
+    logFile << std::endl;
+    logFile.close();
+    PIN_ExitProcess(128 + sig);
+    return FALSE;
+}
+
+// Invertir un bit de memoria de la aplicación; devuelve el byte anterior y
+// el nuevo (ambos 0 y false si la dirección no es accesible)
+bool FlipMemoryBit(ADDRINT ea, UINT64 bit, UINT8& before, UINT8& after) {
+    VOID* byteAddr = reinterpret_cast<VOID*>(ea + bit / 8);
+    before = after = 0;
+    if (PIN_SafeCopy(&before, byteAddr, 1) != 1) {
+        return false;
+    }
+    after = before ^ static_cast<UINT8>(1U << (bit % 8));
+    return PIN_SafeCopy(byteAddr, &after, 1) == 1;
+}
+
+// Invertir el bit elegido del registro destino, ya escrito (IPOINT_AFTER)
+VOID InjectRegisterFault(const InjectionSite* site, PIN_REGISTER* value, THREADID tid) {
+    if (injected.exchange(true)) {
+        return;
+    }
+
+    UINT32 width = REG_Size(site->reg) * 8;
+    UINT32 bit = faultBit % width;
+    UINT64 before = value->qword[bit / 64];
+    value->byte[bit / 8] ^= static_cast<UINT8>(1U << (bit % 8));
+    UINT64 after = value->qword[bit / 64];
+
+    LogInjection(site, tid);
+    logFile << " target=reg"
+            << " reg=" << REG_StringShort(site->reg)
+            << " width=" << width
+            << " bit=" << bit
+            << " before=0x" << std::hex << before
+            << " after=0x" << after << std::dec;
+    FinishInjection(site);
+}
+
+// -target mem, IPOINT_BEFORE de la instancia objetivo: guardar la escritura
+VOID PIN_FAST_ANALYSIS_CALL RecordTargetWrite(ADDRINT ea, UINT32 size, THREADID tid) {
+    pendingWriteSize = size;
+    pendingWriteTid = tid;
+    pendingWriteEa = ea;
+}
+
+// Condición inline en IPOINT_AFTER de los sitios de memoria
+ADDRINT PIN_FAST_ANALYSIS_CALL WritePending(THREADID tid) {
+    return (pendingWriteEa != 0) & (tid == pendingWriteTid);
+}
+
+// -target mem, IPOINT_AFTER: la escritura ya ocurrió, corromper sus bytes
+VOID InjectMemoryFault(const InjectionSite* site, THREADID tid) {
+    ADDRINT ea = pendingWriteEa;
+    pendingWriteEa = 0;
+    if (injected.exchange(true)) {
+        return;
+    }
+
+    UINT32 width = pendingWriteSize * 8;
+    UINT32 bit = faultBit % width;
+    UINT8 before, after;
+    bool ok = FlipMemoryBit(ea, bit, before, after);
+
+    LogInjection(site, tid);
+    logFile << " target=mem"
+            << " ea=0x" << std::hex << ea << std::dec
+            << " width=" << width
+            << " bit=" << bit
+            << " before=0x" << std::hex << static_cast<UINT32>(before)
+            << " after=0x" << static_cast<UINT32>(after) << std::dec;
+    if (!ok) {
+        logFile << " error=unwritable";
+    }
+    FinishInjection(site);
+}
+
+// -target buffer: la instancia objetivo solo marca el momento; el bit cae
+// en los buffers registrados (-bit sobre sus bytes concatenados)
+VOID InjectBufferFault(const InjectionSite* site, THREADID tid) {
+    if (injected.exchange(true)) {
+        return;
+    }
+
+    PIN_GetLock(&buffersLock, tid + 1);
+    UINT64 totalBits = 0;
+    for (const RegisteredBuffer& b : registeredBuffers) {
+        totalBits += b.bytes * 8;
+    }
+
+    LogInjection(site, tid);
+    logFile << " target=buffer";
+    if (totalBits == 0) {
+        logFile << " error=no_buffers";
+    } else {
+        UINT64 bit = faultBit % totalBits;
+        UINT32 index = 0;
+        while (bit >= registeredBuffers[index].bytes * 8) {
+            bit -= registeredBuffers[index].bytes * 8;
+            index++;
+        }
+        const RegisteredBuffer& buffer = registeredBuffers[index];
+        UINT8 before, after;
+        bool ok = FlipMemoryBit(buffer.base, bit, before, after);
+        logFile << " buffer=" << index
+                << " ea=0x" << std::hex << buffer.base + bit / 8 << std::dec
+                << " bit=" << bit
+                << " before=0x" << std::hex << static_cast<UINT32>(before)
+                << " after=0x" << static_cast<UINT32>(after) << std::dec;
+        if (!ok) {
+            logFile << " error=unwritable";
+        }
+    }
+    PIN_ReleaseLock(&buffersLock);
+    FinishInjection(site);
+}
+
+// Marcadores de buffers (roi_markers.h)
+VOID RegisterBuffer(ADDRINT base, ADDRINT bytes) {
+    PIN_GetLock(&buffersLock, PIN_ThreadId() + 1);
+    registeredBuffers.push_back({base, bytes});
+    PIN_ReleaseLock(&buffersLock);
+}
+
+VOID ClearBuffers() {
+    PIN_GetLock(&buffersLock, PIN_ThreadId() + 1);
+    registeredBuffers.clear();
+    PIN_ReleaseLock(&buffersLock);
+}
+
+// Límite entre iteraciones del harness: cerrar la falla anterior y armar la
+// siguiente. Sin más fallas el resto de la ejecución corre nativa
+VOID IterationBoundary(ADDRINT iteration) {
+    if (iterationArmed && !injected.load()) {
+        logFile << "id=" << faultId
+                << " status=not_reached"
+                << " instance=" << targetInstance
+                << " executed=" << (targetInstance - remainingInstances)
+                << std::endl;
+    }
+
+    if (!iterationParams.is_open()) {
+        iterationParams.open(KnobFaultParams.Value().c_str());
+    }
+
+    UINT64 n;
+    UINT32 bit;
+    if (!(iterationParams >> n >> bit) || n == 0) {
+        remainingInstances = ~0ULL;
+        injected = true;
+        logFile << "status=params_exhausted iteration=" << iteration << std::endl;
+        PIN_Detach();
+        return;
+    }
+
+    // El presupuesto vale por iteración: una falla que colgó la anterior ya
+    // habría terminado el proceso
+    if (budgetArmed) {
+        budgetRemaining = static_cast<INT64>(instructionBudget);
+    }
+
+    faultId = iteration;
+    iterationArmed = true;
+    pendingWriteEa = 0;
+    targetInstance = n;
+    faultBit = bit;
+    injected = false;
+    remainingInstances = n;
+}
+
+double NowSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+int AppWaitpid(CONTEXT* ctxt, THREADID tid, int pid, int* status, int options) {
+    int waited = -1;
+    PIN_CallApplicationFunction(ctxt, tid, CALLINGSTD_DEFAULT, appWaitpid, NULL,
+                                PIN_PARG(int), &waited,
+                                PIN_PARG(int), pid,
+                                PIN_PARG(int*), status,
+                                PIN_PARG(int), options,
+                                PIN_PARG_END());
+    return waited;
+}
+
+// Copiar a -o el registro que el hijo dejó en su pipe y cerrar con la línea
+// end= del padre. Los registros son un par de líneas: entran en el buffer
+// del pipe, así el hijo nunca se bloquea esperando que el padre lea
+VOID LogChildEnd(const ForkChild& child, const string& end) {
+    string record;
+    char buffer[4096];
+    ssize_t got;
+    while ((got = read(child.pipeFd, buffer, sizeof(buffer))) > 0) {
+        record.append(buffer, got);
+    }
+    close(child.pipeFd);
+    if (!record.empty() && record.back() != '\n') {
+        record += '\n';
+    }
+    logFile << record
+            << "id=" << child.id << " " << end
+            << " seconds=" << NowSeconds() - child.start << std::endl;
+}
+
+// Esperar a que termine algún hijo (waitpid(-1)) y registrarlo. Mientras
+// tanto se matan los que pasaron -fork_timeout
+VOID ReapChild(CONTEXT* ctxt, THREADID tid, std::map<int, ForkChild>& children) {
+    double timeout = KnobForkTimeout.Value();
+    while (!children.empty()) {
+        int status = 0;
+        int waited = AppWaitpid(ctxt, tid, -1, &status, timeout > 0 ? WNOHANG : 0);
+        if (waited < 0) {
+            // Sin hijos que esperar: los que quedan se perdieron
+            for (const auto& entry : children) {
+                LogChildEnd(entry.second, "end=lost");
+            }
+            children.clear();
+            return;
+        }
+        auto it = children.find(waited);
+        if (waited > 0 && it != children.end()) {
+            std::ostringstream end;
+            if (it->second.killed) {
+                end << "end=timeout";
+            } else if (WIFSIGNALED(status)) {
+                end << "end=signaled signal=" << WTERMSIG(status);
+            } else {
+                end << "end=exited code=" << WEXITSTATUS(status);
+            }
+            LogChildEnd(it->second, end.str());
+            children.erase(it);
+            return;
+        }
+        if (waited == 0) {
+            double now = NowSeconds();
+            for (auto& entry : children) {
+                ForkChild& child = entry.second;
+                if (!child.killed && now - child.start > timeout && appKill != nullptr) {
+                    int ignored = 0;
+                    PIN_CallApplicationFunction(ctxt, tid, CALLINGSTD_DEFAULT, appKill, NULL,
+                                                PIN_PARG(int), &ignored,
+                                                PIN_PARG(int), entry.first,
+                                                PIN_PARG(int), SIGKILL,
+                                                PIN_PARG_END());
+                    child.killed = true;
+                }
+            }
+            PIN_Sleep(1);
+        }
+    }
+}
+
+// Hijo recién creado: registro al pipe, stdout propio (-fork_output) y la
+// falla armada. -n y -count_ins cuentan desde el checkpoint
+VOID StartForkChild(int pipeFd, UINT64 n, UINT32 bit) {
+    logFile.close();
+    logFile.open(("/proc/self/fd/" + std::to_string(pipeFd)).c_str());
+    close(pipeFd);
+
+    if (!KnobForkOutput.Value().empty()) {
+        string path = KnobForkOutput.Value() + std::to_string(faultId) + ".out";
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            close(fd);
+        }
+    }
+
+    targetInstance = n;
+    remainingInstances = n;
+    faultBit = bit;
+    executedInstructions = 0;
+}
+
+// Servidor de fallas: se ejecuta una vez, al entrar al checkpoint. Por cada
+// línea del archivo de parámetros crea un hijo que retoma la ejecución desde
+// acá con su falla, con hasta -fork_jobs hijos a la vez. Cada hijo escribe
+// su registro en un pipe propio; el padre lo copia a -o cuando el hijo
+// termina, seguido de cómo terminó, así los registros no se mezclan
+VOID ForkServerLoop(CONTEXT* ctxt, THREADID tid) {
+    static bool started = false;
+    if (started) {
+        return;
+    }
+    started = true;
+
+    if (appFork == nullptr || appWaitpid == nullptr) {
+        std::cerr << "ERROR: fork/waitpid no encontrados en la aplicación" << std::endl;
+        PIN_ExitApplication(1);
+    }
+
+    std::ifstream params(KnobFaultParams.Value().c_str());
+    if (!params.is_open()) {
+        std::cerr << "ERROR: No se pudo abrir " << KnobFaultParams.Value() << std::endl;
+        PIN_ExitApplication(1);
+    }
+
+    size_t jobs = std::max<UINT32>(1, KnobForkJobs.Value());
+    std::map<int, ForkChild> children;
+    UINT64 n;
+    UINT32 bit;
+    while (params >> n >> bit) {
+        faultId++;
+        if (n == 0) {
+            logFile << "id=" << faultId << " status=invalid" << std::endl;
+            continue;
+        }
+        while (children.size() >= jobs) {
+            ReapChild(ctxt, tid, children);
+        }
+
+        int fds[2];
+        if (pipe(fds) != 0) {
+            logFile << "id=" << faultId << " status=pipe_failed" << std::endl;
+            break;
+        }
+        logFile.flush();
+
+        int pid = -1;
+        PIN_CallApplicationFunction(ctxt, tid, CALLINGSTD_DEFAULT, appFork, NULL,
+                                    PIN_PARG(int), &pid,
+                                    PIN_PARG_END());
+        if (pid == 0) {
+            // Hijo: soltar lo que es del padre y seguir con la aplicación
+            params.close();
+            close(fds[0]);
+            for (const auto& entry : children) {
+                close(entry.second.pipeFd);
+            }
+            StartForkChild(fds[1], n, bit);
+            return;
+        }
+        close(fds[1]);
+        if (pid < 0) {
+            close(fds[0]);
+            logFile << "id=" << faultId << " status=fork_failed" << std::endl;
+            break;
+        }
+        children[pid] = {faultId, fds[0], NowSeconds(), false};
+    }
+    while (!children.empty()) {
+        ReapChild(ctxt, tid, children);
+    }
+
+    // El padre nunca ejecuta la carga de trabajo más allá del checkpoint
+    forkServerParent = true;
+    PIN_ExitApplication(0);
+}
+
+// ============================================================================
+// INSTRUMENTACIÓN
+// ============================================================================
+
+// Aplicar un filtro de funciones al nombre mangled y al demangled de la
+// rutina. Sin patrones no se demangla nada
+bool MatchesFilter(const FunctionFilter& filter, RTN rtn, const string& rtnName) {
+    if (filter.Empty()) {
+        return true;
+    }
+    return filter.Matches(rtnName, symbolNames.Demangled(RTN_Address(rtn), rtnName));
+}
+
+// Registrar una instrucción ya seleccionada como sitio; false si su destino
+// no es observable después de ejecutarse y no se usa
+bool InstrumentSite(INS ins, const string& rtnName, ArithType type) {
+    // Solo cuentan las instancias cuyo destino es observable después de
+    // ejecutarse: registro destino (reg) o escritura a memoria (mem)
+    if (!INS_IsValidForIpointAfter(ins)) {
+        return false;
+    }
+    REG reg = InjectionDestinationRegister(ins);
+    if (injectionTarget == TARGET_REG && !HasInjectableRegister(ins)) {
+        return false;
+    }
+    if (injectionTarget == TARGET_MEM && !HasInjectableWrite(ins)) {
+        return false;
+    }
+
+    injectionSites.push_back({INS_Address(ins), rtnName, INS_Disassemble(ins), reg, type});
+    const InjectionSite* site = &injectionSites.back();
+    sitesByAddress[site->address] = site;
+    sitesLow = std::min(sitesLow, site->address);
+    sitesHigh = std::max(sitesHigh, site->address);
+
+    if (KnobVerbose.Value()) {
+        std::cerr << "Sitio: " << rtnName
+                  << " @ 0x" << std::hex << site->address << std::dec
+                  << " " << site->disassembly << std::endl;
+    }
+    return true;
+}
+
+// Llamadas de un sitio, insertadas al compilar su trace
+VOID InsertSiteCalls(INS ins, const InjectionSite* site) {
+    REG reg = site->reg;
+    if (injectionTarget == TARGET_REG) {
+        INS_InsertIfCall(ins, IPOINT_AFTER, (AFUNPTR)CountdownToTarget,
+                        IARG_FAST_ANALYSIS_CALL,
+                        IARG_END);
+        INS_InsertThenCall(ins, IPOINT_AFTER, (AFUNPTR)InjectRegisterFault,
+                          IARG_PTR, site,
+                          IARG_REG_REFERENCE, reg,
+                          IARG_THREAD_ID,
+                          IARG_END);
+    } else if (injectionTarget == TARGET_MEM) {
+        // Sin traza de memoria: la dirección efectiva solo se materializa
+        // en la instancia objetivo; las demás pagan dos condiciones inline
+        INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)CountdownToTarget,
+                        IARG_FAST_ANALYSIS_CALL,
+                        IARG_END);
+        INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)RecordTargetWrite,
+                          IARG_FAST_ANALYSIS_CALL,
+                          IARG_MEMORYWRITE_EA,
+                          IARG_MEMORYWRITE_SIZE,
+                          IARG_THREAD_ID,
+                          IARG_END);
+        INS_InsertIfCall(ins, IPOINT_AFTER, (AFUNPTR)WritePending,
+                        IARG_FAST_ANALYSIS_CALL,
+                        IARG_THREAD_ID,
+                        IARG_END);
+        INS_InsertThenCall(ins, IPOINT_AFTER, (AFUNPTR)InjectMemoryFault,
+                          IARG_PTR, site,
+                          IARG_THREAD_ID,
+                          IARG_END);
+    } else {
+        INS_InsertIfCall(ins, IPOINT_AFTER, (AFUNPTR)CountdownToTarget,
+                        IARG_FAST_ANALYSIS_CALL,
+                        IARG_END);
+        INS_InsertThenCall(ins, IPOINT_AFTER, (AFUNPTR)InjectBufferFault,
+                          IARG_PTR, site,
+                          IARG_THREAD_ID,
+                          IARG_END);
+    }
+}
+
+// Recorrido completo de una rutina: filtro, clasificación y selección. Si
+// se pasa builder, registra las instrucciones instrumentadas para el cache
+VOID InstrumentRoutine(RTN rtn, ADDRINT imgLow, DecisionCacheBuilder* builder) {
+    if (singleSite && (singleSiteAddress < RTN_Address(rtn) ||
+                       singleSiteAddress >= RTN_Address(rtn) + RTN_Size(rtn))) {
+        return;
+    }
+
+    string rtnName = RTN_Name(rtn);
+
+    // Filtrar por funciones de interés (sin abrir la rutina)
+    if (!singleSite && !MatchesFilter(functionFilter, rtn, rtnName)) {
+        return;
+    }
+
+    RTN_Open(rtn);
+
+    if (builder != nullptr) {
+        builder->BeginRoutine(RTN_Address(rtn) - imgLow, rtnName);
+    }
+
+    for (INS ins = RTN_InsHead(rtn); INS_Valid(ins); ins = INS_Next(ins)) {
+        ArithType type = ClassifyArithmeticInstruction(ins);
+        if (singleSite ? INS_Address(ins) != singleSiteAddress
+                       : !IsSelectedInstruction(ins, type)) {
+            continue;
+        }
+        if (InstrumentSite(ins, rtnName, type) && builder != nullptr) {
+            builder->AddSite(INS_Address(ins) - imgLow, type);
+        }
+    }
+
+    if (builder != nullptr) {
+        builder->EndRoutine();
+    }
+    RTN_Close(rtn);
+}
+
+// Corrida con cache: abrir solo las rutinas con sitios e instrumentar las
+// instrucciones guardadas, sin nombres, filtro ni clasificación
+VOID InstrumentFromCache(IMG img, const DecisionCacheView& cache) {
+    ADDRINT low = IMG_LowAddress(img);
+    for (UINT32 i = 0; i < cache.NumRoutines(); i++) {
+        const DecisionRoutine& r = cache.Routine(i);
+        RTN rtn = RTN_FindByAddress(low + r.offset);
+        if (!RTN_Valid(rtn)) {
+            continue;
+        }
+        const DecisionSite* sites = cache.Sites(r);
+        UINT32 next = 0;
+        string rtnName = cache.Name(r);
+
+        RTN_Open(rtn);
+        for (INS ins = RTN_InsHead(rtn); INS_Valid(ins) && next < r.numSites; ins = INS_Next(ins)) {
+            ADDRINT offset = INS_Address(ins) - low;
+            while (next < r.numSites && sites[next].offset < offset) {
+                next++;
+            }
+            if (next < r.numSites && sites[next].offset == offset) {
+                InstrumentSite(ins, rtnName, static_cast<ArithType>(sites[next].arithType));
+                next++;
+            }
+        }
+        RTN_Close(rtn);
+    }
+}
+
+// Enganchar CryptoInjectorRegisterBuffer/ClearBuffers (-target buffer)
+VOID InstrumentBufferMarkers(IMG img) {
+    RTN rtn = RTN_FindByName(img, CRYPTO_INJECTOR_REGISTER_BUFFER_NAME);
+    if (RTN_Valid(rtn)) {
+        RTN_Open(rtn);
+        RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)RegisterBuffer,
+                      IARG_FUNCARG_ENTRYPOINT_VALUE, 0,
+                      IARG_FUNCARG_ENTRYPOINT_VALUE, 1,
+                      IARG_END);
+        RTN_Close(rtn);
+    }
+    rtn = RTN_FindByName(img, CRYPTO_INJECTOR_CLEAR_BUFFERS_NAME);
+    if (RTN_Valid(rtn)) {
+        RTN_Open(rtn);
+        RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)ClearBuffers, IARG_END);
+        RTN_Close(rtn);
+    }
+}
+
+// Enganchar CryptoInjectorIterationBoundary (-per_iteration)
+VOID InstrumentIterationBoundary(IMG img) {
+    RTN rtn = RTN_FindByName(img, CRYPTO_INJECTOR_ITERATION_NAME);
+    if (RTN_Valid(rtn)) {
+        RTN_Open(rtn);
+        RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)IterationBoundary,
+                      IARG_FUNCARG_ENTRYPOINT_VALUE, 0,
+                      IARG_END);
+        RTN_Close(rtn);
+    }
+}
+
+VOID ImageLoad(IMG img, VOID *v) {
+    if (forkServer) {
+        RTN forkRtn = RTN_FindByName(img, "fork");
+        if (RTN_Valid(forkRtn) && appFork == nullptr) {
+            appFork = (AFUNPTR)RTN_Address(forkRtn);
+        }
+        RTN waitRtn = RTN_FindByName(img, "waitpid");
+        if (RTN_Valid(waitRtn) && appWaitpid == nullptr) {
+            appWaitpid = (AFUNPTR)RTN_Address(waitRtn);
+        }
+        RTN killRtn = RTN_FindByName(img, "kill");
+        if (RTN_Valid(killRtn) && appKill == nullptr) {
+            appKill = (AFUNPTR)RTN_Address(killRtn);
+        }
+    }
+
+    // Los filtros de imagen solo aplican a los sitios de inyección; los
+    // marcadores y el checkpoint se enganchan en todas las imágenes
+    bool instrumentSites;
+    if (singleSite) {
+        // Sitio único: solo la imagen del perfil (nombre completo o sufijo)
+        const string& name = IMG_Name(img);
+        const string& wanted = KnobIpImage.Value();
+        instrumentSites = name.size() >= wanted.size() &&
+                          name.compare(name.size() - wanted.size(), wanted.size(), wanted) == 0;
+        if (instrumentSites) {
+            singleSiteAddress = IMG_LowAddress(img) + KnobIpOffset.Value();
+        }
+    } else {
+        // Filtrar bibliotecas si es necesario
+        instrumentSites = KnobIncludeLibraries.Value() || IMG_Type(img) != IMG_TYPE_SHAREDLIB;
+    }
+
+    if (injectionTarget == TARGET_BUFFER) {
+        InstrumentBufferMarkers(img);
+    }
+    if (perIteration) {
+        InstrumentIterationBoundary(img);
+    }
+
+    // Con cache de decisiones válido los sitios salen del archivo mapeado;
+    // si falta, el recorrido completo lo genera para las próximas corridas
+    string cachePath;
+    DecisionCacheBuilder builder;
+    bool buildCache = false;
+    if (instrumentSites && !singleSite && !decisionCacheDir.empty()) {
+        string buildId = ReadElfBuildId(IMG_Name(img));
+        if (!buildId.empty()) {
+            cachePath = DecisionCachePath(decisionCacheDir, buildId, decisionOptionsHash);
+            DecisionCacheView cache;
+            if (cache.Open(cachePath, decisionOptionsHash, ARITH_NUM_TYPES)) {
+                InstrumentFromCache(img, cache);
+                instrumentSites = false;
+                if (KnobVerbose.Value()) {
+                    std::cerr << "Cache de decisiones: " << cachePath
+                              << " (" << cache.NumRoutines() << " rutinas)" << std::endl;
+                }
+            } else {
+                buildCache = true;
+            }
+        }
+    }
+
+    if (!forkServer && !instrumentSites) {
+        return;
+    }
+
+    ADDRINT low = IMG_LowAddress(img);
+    for (SEC sec = IMG_SecHead(img); SEC_Valid(sec); sec = SEC_Next(sec)) {
+        for (RTN rtn = SEC_RtnHead(sec); RTN_Valid(rtn); rtn = RTN_Next(rtn)) {
+            if (forkServer && MatchesFilter(checkpointFilter, rtn, RTN_Name(rtn))) {
+                RTN_Open(rtn);
+                RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)ForkServerLoop,
+                              IARG_CONTEXT,
+                              IARG_THREAD_ID,
+                              IARG_END);
+                RTN_Close(rtn);
+            }
+            if (instrumentSites) {
+                InstrumentRoutine(rtn, low, buildCache ? &builder : nullptr);
+            }
+        }
+    }
+
+    if (buildCache && !builder.Write(cachePath, decisionOptionsHash) && KnobVerbose.Value()) {
+        std::cerr << "No se pudo escribir el cache de decisiones " << cachePath << std::endl;
+    }
+}
+
+// Sitios de inyección, contador de la corrida dorada y presupuesto del
+// watchdog. Los dos conteos se cargan una vez por trace con todas sus
+// instrucciones: una salida temprana cuenta de más, pero igual en la
+// corrida dorada y en las fallas, así -budget compara lo mismo. El
+// presupuesto solo se inserta en traces compilados después de la inyección,
+// y desde ahí los sitios ya no se insertan (salvo por iteración)
+VOID InstrumentTrace(TRACE trace, VOID *v) {
+    bool sitesLive = (perIteration || !injected.load()) &&
+                     TRACE_Address(trace) <= sitesHigh &&
+                     TRACE_Address(trace) + TRACE_Size(trace) > sitesLow;
+    if (sitesLive) {
+        for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+            for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+                auto it = sitesByAddress.find(INS_Address(ins));
+                if (it != sitesByAddress.end()) {
+                    InsertSiteCalls(ins, it->second);
+                }
+            }
+        }
+    }
+
+    if (countInstructions) {
+        TRACE_InsertCall(trace, IPOINT_BEFORE, (AFUNPTR)CountInstructions,
+                        IARG_FAST_ANALYSIS_CALL,
+                        IARG_UINT32, TRACE_NumIns(trace),
+                        IARG_END);
+    }
+    if (budgetArmed) {
+        TRACE_InsertIfCall(trace, IPOINT_BEFORE, (AFUNPTR)ConsumeBudget,
+                          IARG_FAST_ANALYSIS_CALL,
+                          IARG_UINT32, TRACE_NumIns(trace),
+                          IARG_END);
+        TRACE_InsertThenCall(trace, IPOINT_BEFORE, (AFUNPTR)BudgetExhausted,
+                            IARG_INST_PTR,
+                            IARG_THREAD_ID,
+                            IARG_END);
+    }
+}
+
+// ============================================================================
+// FINALIZACIÓN
+// ============================================================================
+
+// Tras PIN_Detach no se llama a Fini
+VOID Detached(VOID *v) {
+    logFile.close();
+}
+
+VOID Fini(INT32 code, VOID *v) {
+    if (forkServerParent) {
+        logFile << "status=server_done faults=" << faultId << std::endl;
+        logFile.close();
+        return;
+    }
+    if (forkServer || perIteration) {
+        logFile << "id=" << faultId << " ";
+    }
+    if (!injected.load()) {
+        logFile << "status=not_reached"
+                << " instance=" << targetInstance
+                << " executed=" << (targetInstance - remainingInstances)
+                << " sites=" << injectionSites.size()
+                << std::endl;
+    }
+    LogOutcome("completed");
+    logFile << " exit_code=" << code;
+    if (countInstructions) {
+        logFile << " instructions=" << executedInstructions;
+    }
+    logFile << std::endl;
+    logFile.close();
+}
+
+INT32 Usage() {
+    std::cerr << "Esta pintool invierte un bit del registro destino de la N-ésima" << std::endl;
+    std::cerr << "instancia dinámica de las instrucciones seleccionadas" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << KNOB_BASE::StringKnobSummary() << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Opciones:" << std::endl;
+    std::cerr << "  -f <func>   Filtrar función específica (repetible)" << std::endl;
+    std::cerr << "  -f_regex <re>    Funciones que encajan (., [], *, +, ?, ^, $; repetible)" << std::endl;
+    std::cerr << "  -f_exclude <sub> Excluir funciones cuyo nombre contiene <sub> (repetible)" << std::endl;
+    std::cerr << "  -op <op>    Opcode (VPADDQ) o familia (SIMD_ADD, FMA, ...) (repetible)" << std::endl;
+    std::cerr << "  -n <n>      Instancia dinámica objetivo, desde 1 (default: 1)" << std::endl;
+    std::cerr << "  -bit <b>    Bit a invertir, módulo el ancho del destino (default: 0)" << std::endl;
+    std::cerr << "  -target reg|mem|buffer  Registro destino, escritura a memoria de la" << std::endl;
+    std::cerr << "              instrucción o buffers registrados (default: reg)" << std::endl;
+    std::cerr << "  -ip_image <img> -ip_offset <off>  Sitio único (de un perfil -ip_profile)" << std::endl;
+    std::cerr << "  -detach 0/1 Seguir nativo tras inyectar (default: 1)" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Watchdog (Pin sigue acoplado tras inyectar, sin los sitios; cada opción sola):" << std::endl;
+    std::cerr << "  -budget <n>       Instrucciones tras la inyección antes de outcome=hang" << std::endl;
+    std::cerr << "                    (descontadas por trace, como -count_ins)" << std::endl;
+    std::cerr << "  -catch_signals 1  Registrar outcome=crash ante SIGSEGV/SIGBUS/SIGFPE/SIGILL/SIGABRT" << std::endl;
+    std::cerr << "  -count_ins 1      Informar instructions= al final (corrida dorada)" << std::endl;
+    std::cerr << "  -l 0/1      Incluir bibliotecas dinámicas (default: 0)" << std::endl;
+    std::cerr << "  -decision_cache <dir>  Guardar/reusar rutinas e instrucciones a" << std::endl;
+    std::cerr << "              instrumentar por build-id de cada imagen" << std::endl;
+    std::cerr << "  -v 0/1      Modo verbose (default: 0)" << std::endl;
+    std::cerr << "  -o <file>   Registro de la inyección (default: injection.log)" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Modo fork-server:" << std::endl;
+    std::cerr << "  -checkpoint <rutina>  Correr hasta la rutina y crear un hijo por falla" << std::endl;
+    std::cerr << "  -params <pipe>        Fallas '<n> <bit>' por línea (default: fault_params.fifo)" << std::endl;
+    std::cerr << "  -fork_jobs <n>        Hijos corriendo a la vez (default: 1)" << std::endl;
+    std::cerr << "  -fork_timeout <s>     Matar a un hijo tras s segundos: end=timeout (default: 0)" << std::endl;
+    std::cerr << "  -fork_output <pref>   stdout de cada hijo a <pref><id>.out" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Modo por iteración (harness en un solo proceso):" << std::endl;
+    std::cerr << "  -per_iteration 1      Armar una falla de -params en cada límite de iteración" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Ejemplo:" << std::endl;
+    std::cerr << "  pin -t FaultInjector.so -f Encrypt -op VPADDQ -n 5000 -bit 17 -- ./programa" << std::endl;
+    std::cerr << "  pin -t FaultInjector.so -checkpoint Encrypt -params p.fifo -o out.fifo -- ./programa" << std::endl;
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    PIN_InitSymbols();
+
+    if (PIN_Init(argc, argv)) {
+        return Usage();
+    }
+
+    if (KnobInstance.Value() == 0) {
+        std::cerr << "ERROR: -n es 1-based" << std::endl;
+        return Usage();
+    }
+    targetInstance = KnobInstance.Value();
+    remainingInstances = targetInstance;
+    faultBit = KnobBit.Value();
+
+    if (KnobTarget.Value() == "reg") {
+        injectionTarget = TARGET_REG;
+    } else if (KnobTarget.Value() == "mem") {
+        injectionTarget = TARGET_MEM;
+    } else if (KnobTarget.Value() == "buffer") {
+        injectionTarget = TARGET_BUFFER;
+    } else {
+        std::cerr << "ERROR: -target debe ser reg, mem o buffer" << std::endl;
+        return Usage();
+    }
+    PIN_InitLock(&buffersLock);
+    singleSite = !KnobIpImage.Value().empty();
+
+    countInstructions = KnobCountInstructions.Value();
+    instructionBudget = KnobBudget.Value();
+    watchdog = instructionBudget > 0 || KnobCatchSignals.Value();
+    if (KnobCatchSignals.Value()) {
+        const INT32 fatalSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+        for (INT32 sig : fatalSignals) {
+            PIN_InterceptSignal(sig, InterceptFatalSignal, 0);
+        }
+    }
+
+    // En modo fork-server nada se inyecta antes del checkpoint
+    if (!KnobCheckpoint.Value().empty()) {
+        forkServer = true;
+        checkpointFilter.AddPattern(KnobCheckpoint.Value());
+        checkpointFilter.Compile();
+        remainingInstances = ~0ULL;
+    }
+
+    // En modo por iteración la primera falla se arma en el primer límite
+    if (KnobPerIteration.Value()) {
+        perIteration = true;
+        remainingInstances = ~0ULL;
+    }
+
+    logFile.open(KnobOutputFile.Value().c_str());
+    if (!logFile.is_open()) {
+        std::cerr << "ERROR: No se pudo abrir " << KnobOutputFile.Value() << std::endl;
+        return -1;
+    }
+
+    for (UINT32 i = 0; i < KnobFunctionFilter.NumberOfValues(); i++) {
+        if (!KnobFunctionFilter.Value(i).empty()) {
+            functionFilter.AddPattern(KnobFunctionFilter.Value(i));
+        }
+    }
+    for (UINT32 i = 0; i < KnobFunctionRegex.NumberOfValues(); i++) {
+        const string& regex = KnobFunctionRegex.Value(i);
+        if (!regex.empty() && !functionFilter.AddRegex(regex)) {
+            std::cerr << "ERROR: expresión regular inválida: " << regex << std::endl;
+            return Usage();
+        }
+    }
+    for (UINT32 i = 0; i < KnobFunctionExclude.NumberOfValues(); i++) {
+        functionFilter.AddExclude(KnobFunctionExclude.Value(i));
+    }
+    functionFilter.Compile();
+
+    for (UINT32 i = 0; i < KnobOpcode.NumberOfValues(); i++) {
+        if (!KnobOpcode.Value(i).empty()) {
+            selectedOps.insert(ToUpper(KnobOpcode.Value(i)));
+        }
+    }
+
+    // Clave del cache: todo lo que decide qué rutinas e instrucciones se
+    // instrumentan (el orden de -f no importa para Matches, pero se respeta)
+    decisionCacheDir = KnobDecisionCache.Value();
+    if (!decisionCacheDir.empty()) {
+        mkdir(decisionCacheDir.c_str(), 0755);
+        string options = "v3 target=" + KnobTarget.Value();
+        for (UINT32 i = 0; i < KnobFunctionFilter.NumberOfValues(); i++) {
+            options += " f=" + KnobFunctionFilter.Value(i);
+        }
+        for (UINT32 i = 0; i < KnobFunctionRegex.NumberOfValues(); i++) {
+            options += " f_regex=" + KnobFunctionRegex.Value(i);
+        }
+        for (UINT32 i = 0; i < KnobFunctionExclude.NumberOfValues(); i++) {
+            options += " f_exclude=" + KnobFunctionExclude.Value(i);
+        }
+        for (const string& op : selectedOps) {
+            options += " op=" + op;
+        }
+        decisionOptionsHash = HashOptions(options);
+    }
+
+    IMG_AddInstrumentFunction(ImageLoad, 0);
+    TRACE_AddInstrumentFunction(InstrumentTrace, 0);
+    PIN_AddDetachFunction(Detached, 0);
+    PIN_AddFiniFunction(Fini, 0);
+
+    PIN_StartProgram();
+
+    return 0;
+}
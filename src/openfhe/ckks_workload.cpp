@@ -0,0 +1,237 @@
+// Parametrized CKKS workload for profiling and injection campaigns.
+//
+// Builds a context with the requested ring dimension, depth and scaling
+// technique, then runs an operation sequence (same syntax as ParsePipeline)
+// `--repeat` times per iteration. The phases are setup (GenCryptoContext),
+// keygen (secret, relinearization and rotation keys) and ops (encrypt and
+// the sequence). The phase selected with --roi is bracketed with
+// CryptoInjectorRoiBegin/End, so `inst_counter -roi 1` counts only that
+// phase. Per-phase wall times are printed as key=value lines.
+//
+// With --harness <n> the sequence is instead replayed n times in-process by
+// CkksHarness (utils_ckks.h) and every replay is classified against the
+// golden one; FaultInjector -per_iteration arms one fault per replay.
+//
+// Example (production-sized parameters):
+//   ckks_workload --ring-dim 65536 --depth 20 --ops mult,rescale --repeat 20
+
+#include "openfhe.h"
+#include "../utils_ckks.h"
+#include "../common/roi_markers.h"
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace lbcrypto;
+
+struct WorkloadConfig {
+    uint32_t ringDim = 1 << 15;
+    uint32_t multDepth = 20;
+    uint32_t firstMod = 60;
+    uint32_t scaleMod = 50;
+    uint32_t batchSize = 0;          // 0: ringDim / 2
+    ScalingTechnique scalingTechnique = FIXEDMANUAL;
+    std::vector<PipelineOp> ops = {{PIPELINE_EVAL_MULT}, {PIPELINE_RESCALE}};
+    uint32_t repeat = 1;
+    uint32_t iterations = 1;
+    uint64_t seed = 1;
+    std::string roi = "ops";         // setup, keygen, ops or all
+    uint64_t harnessIterations = 0;  // --harness: CkksHarness replays
+};
+
+static void Usage() {
+    std::cerr << "Usage: ckks_workload [options]\n"
+              << "  --ring-dim <n>     ring dimension (default 32768)\n"
+              << "  --depth <n>        multiplicative depth (default 20)\n"
+              << "  --first-mod <n>    first modulus size in bits (default 60)\n"
+              << "  --scale-mod <n>    scaling modulus size in bits (default 50)\n"
+              << "  --batch <n>        slots (default ring-dim / 2)\n"
+              << "  --scaling <name>   FIXEDMANUAL, FIXEDAUTO, FLEXIBLEAUTO, FLEXIBLEAUTOEXT\n"
+              << "  --ops <list>       operation sequence, e.g. encrypt,mult,rescale,add,rotate:1\n"
+              << "                     (a fresh encryption is used if it does not start with encrypt)\n"
+              << "  --repeat <n>       repetitions of the sequence per iteration (default 1)\n"
+              << "  --iterations <n>   iterations of the ops phase (default 1)\n"
+              << "  --seed <n>         PRNG seed (default 1)\n"
+              << "  --roi <phase>      setup, keygen, ops or all (default ops)\n"
+              << "  --harness <n>      replay the sequence n times in-process and classify\n"
+              << "                     each replay (FaultInjector -per_iteration)" << std::endl;
+}
+
+static bool ParseArgs(int argc, char* argv[], WorkloadConfig& cfg) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--ring-dim") {
+            cfg.ringDim = std::stoul(value);
+        } else if (arg == "--depth") {
+            cfg.multDepth = std::stoul(value);
+        } else if (arg == "--first-mod") {
+            cfg.firstMod = std::stoul(value);
+        } else if (arg == "--scale-mod") {
+            cfg.scaleMod = std::stoul(value);
+        } else if (arg == "--batch") {
+            cfg.batchSize = std::stoul(value);
+        } else if (arg == "--scaling") {
+            cfg.scalingTechnique = ParseScalingTechnique(value);
+        } else if (arg == "--ops") {
+            cfg.ops = ParsePipeline(value);
+        } else if (arg == "--repeat") {
+            cfg.repeat = std::stoul(value);
+        } else if (arg == "--iterations") {
+            cfg.iterations = std::stoul(value);
+        } else if (arg == "--seed") {
+            cfg.seed = std::stoull(value);
+        } else if (arg == "--roi") {
+            if (value != "setup" && value != "keygen" && value != "ops" && value != "all") {
+                throw std::invalid_argument("unknown phase: " + value);
+            }
+            cfg.roi = value;
+        } else if (arg == "--harness") {
+            cfg.harnessIterations = std::stoull(value);
+        } else {
+            return false;
+        }
+    }
+    if (cfg.batchSize == 0) {
+        cfg.batchSize = cfg.ringDim / 2;
+    }
+    return true;
+}
+
+// Enter/leave the region of interest around the phase selected with --roi
+class Phase {
+public:
+    Phase(const char* name, const WorkloadConfig& cfg)
+        : name(name), marked(cfg.roi == name || cfg.roi == "all"),
+          start(std::chrono::steady_clock::now()) {
+        if (marked) {
+            CryptoInjectorRoiBegin();
+        }
+    }
+
+    ~Phase() {
+        if (marked) {
+            CryptoInjectorRoiEnd();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "phase=" << name << " seconds=" << elapsed.count() << std::endl;
+    }
+
+private:
+    const char* name;
+    bool marked;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Values in [0, 1) so repeated squaring stays bounded
+static std::vector<double> WorkloadInput(const WorkloadConfig& cfg) {
+    std::vector<double> input(cfg.batchSize);
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = static_cast<double>(i % 1024) / 1024;
+    }
+    return input;
+}
+
+// --harness: the sequence (repeated --repeat times) becomes the harness
+// pipeline; one key=value line per replay on stdout
+static int RunHarness(const WorkloadConfig& cfg) {
+    HarnessConfig harness;
+    harness.multDepth = cfg.multDepth;
+    harness.ringDim = cfg.ringDim;
+    harness.firstMod = cfg.firstMod;
+    harness.scaleMod = cfg.scaleMod;
+    harness.batchSize = cfg.batchSize;
+    harness.scalingTechnique = cfg.scalingTechnique;
+    harness.seed = cfg.seed;
+    harness.input = WorkloadInput(cfg);
+    harness.pipeline.clear();
+    for (uint32_t r = 0; r < cfg.repeat; r++) {
+        harness.pipeline.insert(harness.pipeline.end(), cfg.ops.begin(), cfg.ops.end());
+    }
+
+    try {
+        CkksHarness runner(harness);
+        runner.Run(cfg.harnessIterations, std::cout);
+    } catch (const std::exception& e) {
+        // Raised while building the golden replay, before any iteration
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    WorkloadConfig cfg;
+    try {
+        if (!ParseArgs(argc, argv, cfg)) {
+            Usage();
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        Usage();
+        return 1;
+    }
+
+    std::cout << "ring_dim=" << cfg.ringDim << " depth=" << cfg.multDepth
+              << " batch=" << cfg.batchSize << " repeat=" << cfg.repeat
+              << " iterations=" << cfg.iterations << std::endl;
+
+    if (cfg.harnessIterations > 0) {
+        return RunHarness(cfg);
+    }
+
+    CryptoContext<DCRTPoly> cc;
+    {
+        Phase phase("setup", cfg);
+        CCParams<CryptoContextCKKSRNS> parameters;
+        parameters.SetMultiplicativeDepth(cfg.multDepth);
+        parameters.SetScalingModSize(cfg.scaleMod);
+        parameters.SetFirstModSize(cfg.firstMod);
+        parameters.SetBatchSize(cfg.batchSize);
+        parameters.SetRingDim(cfg.ringDim);
+        parameters.SetScalingTechnique(cfg.scalingTechnique);
+        parameters.SetSecurityLevel(HEStd_NotSet);
+
+        cc = GenCryptoContext(parameters);
+        cc->Enable(PKE);
+        cc->Enable(KEYSWITCH);
+        cc->Enable(LEVELEDSHE);
+    }
+
+    KeyPair<DCRTPoly> keys;
+    {
+        Phase phase("keygen", cfg);
+        PseudoRandomNumberGenerator::GetPRNG().SetSeed(cfg.seed);
+        keys = GeneratePipelineKeys(cc, cfg.ops);
+    }
+
+    Plaintext plaintext = cc->MakeCKKSPackedPlaintext(WorkloadInput(cfg));
+
+    Ciphertext<DCRTPoly> ct;
+    try {
+        Phase phase("ops", cfg);
+        for (uint32_t it = 0; it < cfg.iterations; it++) {
+            PseudoRandomNumberGenerator::GetPRNG().ResetToSeed();
+            if (cfg.ops.empty() || cfg.ops[0].type != PIPELINE_ENCRYPT) {
+                ct = cc->Encrypt(keys.publicKey, plaintext);
+            }
+            for (uint32_t r = 0; r < cfg.repeat; r++) {
+                for (const PipelineOp& op : cfg.ops) {
+                    ct = ApplyPipelineOp(cc, keys.publicKey, plaintext, op, ct);
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        // Typically the sequence needs more levels than --depth provides
+        std::cerr << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "level=" << ct->GetLevel() << std::endl;
+    return 0;
+}
@@ -1,39 +1,9 @@
 #include "openfhe.h"
-#include <random>
+#include "../utils_ckks.h"
 #include <iostream>
 
-int random_int(int min, int max) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> dist(min, max);
-    return dist(gen);
-}
-
 using namespace lbcrypto;
 
-bool compareCoefficients(const Ciphertext<DCRTPoly>& c1,
-                         const Ciphertext<DCRTPoly>& c2,
-                         int numSamples = 10) {
-    const auto& elem1 = c1->GetElements()[0].GetAllElements();
-    const auto& elem2 = c2->GetElements()[0].GetAllElements();
-
-    int numLimbs = elem1.size();
-    if (numLimbs == 0) return false;
-
-    int ringDimension = elem1[0].GetLength();
-
-    // Verify multiple random coefficients
-    for (int i = 0; i < numSamples; i++) {
-        int limb = random_int(0, numLimbs - 1);
-        int coeff = random_int(0, ringDimension - 1);
-
-        if (elem1[limb][coeff] != elem2[limb][coeff]) {
-            return false;
-        }
-    }
-    return true;
-}
-
 int main(int argc, char* argv[]) {
     uint64_t seed = 1;
     uint32_t multDepth = 3;
@@ -69,45 +39,64 @@ int main(int argc, char* argv[]) {
     prng.ResetToSeed();
     auto c_2 = cc->Encrypt(keys.publicKey, ptxt1);
 
-    bool test1 = compareCoefficients(c_1, c_2, 20);
+    bool test1 = CompareCiphertexts(c_1, c_2).identical;
     std::cout << "Test 1 (SetSeed == ResetToSeed): "
               << (test1 ? "PASS" : "FAIL") << std::endl;
 
     // Test 2: Without reset, next ciphertext should be different
     auto c_3 = cc->Encrypt(keys.publicKey, ptxt1);
-    bool test2 = !compareCoefficients(c_1, c_3, 20);
+    bool test2 = !CompareCiphertexts(c_1, c_3).identical;
     std::cout << "Test 2 (next ciphertext different): "
               << (test2 ? "PASS" : "FAIL") << std::endl;
 
     // Test 3: Reset again should return to same sequence
     prng.ResetToSeed();
     auto c_4 = cc->Encrypt(keys.publicKey, ptxt1);
-    bool test3 = compareCoefficients(c_1, c_4, 20);
+    bool test3 = CompareCiphertexts(c_1, c_4).identical;
     std::cout << "Test 3 (reset returns to start): "
               << (test3 ? "PASS" : "FAIL") << std::endl;
 
     // Test 4: Changing seed produces different ciphertexts
     prng.SetSeed(seed + 42);
     auto c_5 = cc->Encrypt(keys.publicKey, ptxt1);
-    bool test4 = !compareCoefficients(c_1, c_5, 20);
+    bool test4 = !CompareCiphertexts(c_1, c_5).identical;
     std::cout << "Test 4 (different seed): "
               << (test4 ? "PASS" : "FAIL") << std::endl;
 
     // Test 5: Reset to new seed works
     prng.ResetToSeed();
     auto c_6 = cc->Encrypt(keys.publicKey, ptxt1);
-    bool test5 = compareCoefficients(c_5, c_6, 20);
+    bool test5 = CompareCiphertexts(c_5, c_6).identical;
     std::cout << "Test 5 (reset to new seed): "
               << (test5 ? "PASS" : "FAIL") << std::endl;
 
     // Test 6: Return to original seed
     prng.SetSeed(seed);
     auto c_7 = cc->Encrypt(keys.publicKey, ptxt1);
-    bool test6 = compareCoefficients(c_1, c_7, 20);
+    bool test6 = CompareCiphertexts(c_1, c_7).identical;
     std::cout << "Test 6 (return to original seed): "
               << (test6 ? "PASS" : "FAIL") << std::endl;
 
-    bool allPassed = test1 && test2 && test3 && test4 && test5 && test6;
+    // Test 7: Identical ciphertexts classify as masked, a different one does not
+    std::vector<double> goldenValues = DecryptReal(cc, keys.secretKey, c_1, input.size());
+    bool test7 = ClassifyFault(cc, keys.secretKey, c_7, c_1, goldenValues, 1e-6) == OUTCOME_MASKED &&
+                 ClassifyFault(cc, keys.secretKey, c_3, c_1, goldenValues, 1e-6) != OUTCOME_MASKED;
+    std::cout << "Test 7 (outcome classification): "
+              << (test7 ? "PASS" : "FAIL") << std::endl;
+
+    // Test 8: Without faults, every in-process harness replay matches the golden run
+    HarnessConfig harnessConfig;
+    harnessConfig.seed = seed;
+    harnessConfig.pipeline = ParsePipeline("encrypt,mult,rescale,add");
+    CkksHarness harness(harnessConfig);
+    bool test8 = true;
+    for (uint64_t i = 0; i < 4; i++) {
+        test8 = harness.RunIteration(i).outcome == OUTCOME_MASKED && test8;
+    }
+    std::cout << "Test 8 (harness replays are masked): "
+              << (test8 ? "PASS" : "FAIL") << std::endl;
+
+    bool allPassed = test1 && test2 && test3 && test4 && test5 && test6 && test7 && test8;
 
     std::cout << "\n=================================\n";
     if (allPassed) {
@@ -0,0 +1,89 @@
+// Conversor de perfiles binarios de inst_counter (-format bin).
+//
+// Mapea el perfil y lo reemite como JSON o CSV (mismas tablas que
+// -format json|csv), o muestra un resumen con las funciones más calientes.
+// Las tablas se recorren en el archivo mapeado, sin cargarlas en memoria.
+
+#include "profile_format.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::string;
+
+int Usage() {
+    std::cerr << "Uso: profconv <perfil.bin> [json|csv|summary] [salida]" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  json, csv   Exportar todas las tablas (default: json, a stdout)" << std::endl;
+    std::cerr << "  summary     Totales y las 20 funciones más calientes" << std::endl;
+    return 1;
+}
+
+int Summary(const ProfileView& view) {
+    const ProfileHeader& h = view.Header();
+    std::cout << "total=" << h.total << " sampling=" << JsonProfileSink::SamplingName(h.sampling)
+              << " functions=" << view.Rows(PROFILE_FUNCTIONS)
+              << " ips=" << view.Rows(PROFILE_IPS)
+              << " contexts=" << view.Rows(PROFILE_CONTEXTS) << std::endl;
+
+    // Solo índices: los registros se leen del mapeo
+    uint64_t rows = view.Rows(PROFILE_FUNCTIONS);
+    std::vector<uint64_t> order(rows);
+    for (uint64_t i = 0; i < rows; i++) {
+        order[i] = i;
+    }
+    size_t top = std::min<size_t>(20, rows);
+    std::partial_sort(order.begin(), order.begin() + top, order.end(),
+                      [&view](uint64_t a, uint64_t b) {
+                          return view.Row<ProfileFunctionRecord>(PROFILE_FUNCTIONS, a)->total >
+                                 view.Row<ProfileFunctionRecord>(PROFILE_FUNCTIONS, b)->total;
+                      });
+    for (size_t i = 0; i < top; i++) {
+        const ProfileFunctionRecord* f = view.Row<ProfileFunctionRecord>(PROFILE_FUNCTIONS, order[i]);
+        if (f->total == 0) {
+            break;
+        }
+        std::printf("%16llu  %s\n", static_cast<unsigned long long>(f->total), view.String(f->name));
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 4) {
+        return Usage();
+    }
+    string format = argc > 2 ? argv[2] : "json";
+    if (format != "json" && format != "csv" && format != "summary") {
+        return Usage();
+    }
+
+    ProfileView view;
+    if (!view.Open(argv[1])) {
+        std::cerr << "ERROR: " << argv[1] << " no es un perfil binario de inst_counter" << std::endl;
+        return 1;
+    }
+    if (format == "summary") {
+        return Summary(view);
+    }
+
+    FILE* out = argc > 3 ? std::fopen(argv[3], "w") : stdout;
+    if (out == nullptr) {
+        std::cerr << "ERROR: no se pudo crear " << argv[3] << std::endl;
+        return 1;
+    }
+    JsonProfileSink jsonSink(out);
+    CsvProfileSink csvSink(out);
+    ProfileSink& sink = format == "json" ? static_cast<ProfileSink&>(jsonSink) :
+                                           static_cast<ProfileSink&>(csvSink);
+    bool ok = ReplayProfile(view, sink);
+    if (out != stdout) {
+        ok = std::fclose(out) == 0 && ok;
+    }
+    if (!ok) {
+        std::cerr << "ERROR: no se pudo escribir la salida" << std::endl;
+        return 1;
+    }
+    return 0;
+}
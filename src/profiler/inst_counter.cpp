@@ -1,81 +1,170 @@
 #include "pin.H"
+#include "roi_markers.h"
+#include "arith_classify.h"
+#include "function_filter.h"
+#include "symbol_names.h"
+#include "ip_profile.h"
+#include "live_stats.h"
+#include "profile_format.h"
 #include <iostream>
 #include <fstream>
 #include <map>
 #include <set>
 #include <string>
 #include <vector>
+#include <deque>
+#include <unordered_map>
 #include <algorithm>
 #include <iomanip>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 using std::string;
 using std::map;
 using std::set;
 using std::vector;
+using std::deque;
+using std::unordered_map;
 using std::pair;
 
 // ============================================================================
 // ESTRUCTURAS DE DATOS
 // ============================================================================
 
-// Tipos de instrucciones aritméticas
-enum ArithType {
-    ARITH_ADD,
-    ARITH_SUB,
-    ARITH_MUL,
-    ARITH_DIV,
-    ARITH_INC,
-    ARITH_DEC,
-    ARITH_NEG,
-    ARITH_IMUL,
-    ARITH_IDIV,
-    // SIMD Integer
-    ARITH_SIMD_ADD,
-    ARITH_SIMD_SUB,
-    ARITH_SIMD_MUL,
-    // AVX/SSE Floating Point
-    ARITH_SSE_ADD,
-    ARITH_SSE_SUB,
-    ARITH_SSE_MUL,
-    ARITH_SSE_DIV,
-    ARITH_AVX_ADD,
-    ARITH_AVX_SUB,
-    ARITH_AVX_MUL,
-    ARITH_AVX_DIV,
-    // FPU
-    ARITH_FPU_ADD,
-    ARITH_FPU_SUB,
-    ARITH_FPU_MUL,
-    ARITH_FPU_DIV,
-    ARITH_UNKNOWN
+// Slot inválido (sin capacidad en los arreglos de contadores)
+const UINT32 INVALID_SLOT = ~0U;
+
+// Slots reservados al comienzo del arreglo de cada thread:
+// - TOTAL_SLOT: total de instrucciones aritméticas del thread, usado para
+//   atribuir conteos a contextos de llamada (-track 1) y para medir rebanadas
+// - SAMPLE_COUNTDOWN_SLOT / SAMPLE_RNG_SLOT: cuenta regresiva y estado del
+//   generador aleatorio del muestreo 1-de-N (-sample bbl)
+const UINT32 TOTAL_SLOT = 0;
+const UINT32 SAMPLE_COUNTDOWN_SLOT = 1;
+const UINT32 SAMPLE_RNG_SLOT = 2;
+const UINT32 RESERVED_SLOTS = 3;
+
+// Modos de muestreo (-sample)
+enum SampleMode {
+    SAMPLE_NONE,
+    SAMPLE_BBL,     // 1 de cada N ejecuciones de BBL (N aleatorio con media -sample_period)
+    SAMPLE_SLICE    // alternar rebanadas de tiempo instrumentadas y nativas
 };
 
-// Mapa de nombres para cada tipo
-const char* ArithTypeNames[] = {
-    "ADD", "SUB", "MUL", "DIV", "INC", "DEC", "NEG", "IMUL", "IDIV",
-    "SIMD_ADD", "SIMD_SUB", "SIMD_MUL",
-    "SSE_ADD", "SSE_SUB", "SSE_MUL", "SSE_DIV",
-    "AVX_ADD", "AVX_SUB", "AVX_MUL", "AVX_DIV",
-    "FPU_ADD", "FPU_SUB", "FPU_MUL", "FPU_DIV",
-    "UNKNOWN"
-};
+// Z para intervalos de confianza del 95%
+const double CONFIDENCE_Z = 1.96;
 
-// Contadores por función
+// Contadores por función. Cada función tiene ARITH_NUM_TYPES slots
+// contiguos (indexados por ArithType) a partir de firstSlot en el arreglo
+// de contadores de cada thread: en tiempo de instrumentación se pasa a cada
+// instrucción su número de slot, así el análisis es un único incremento sin
+// búsquedas. arithCounts y totalArithInstructions se calculan al final
+// sumando todos los threads (ver Fini).
 struct FunctionStats {
     string name;
     ADDRINT address;
-    map<ArithType, UINT64> arithCounts;
+    UINT32 id;
+    UINT32 firstSlot;
+    UINT64 arithCounts[ARITH_NUM_TYPES];
     UINT64 totalArithInstructions;
+    double arithVariance;   // muestreo: varianza del total estimado
+    double arithBound;      // muestreo: semiancho del IC 95% del total
     bool isInlined;
 
-    FunctionStats() : address(0), totalArithInstructions(0), isInlined(false) {}
+    FunctionStats() : address(0), id(0), firstSlot(INVALID_SLOT),
+                      totalArithInstructions(0), arithVariance(0), arithBound(0),
+                      isInlined(false) {
+        memset(arithCounts, 0, sizeof(arithCounts));
+    }
+};
+
+// Histograma de un bloque básico (modo -bbl 1). El histograma por tipo se
+// calcula una sola vez al instrumentar; en ejecución solo se incrementa el
+// slot de ejecuciones y los conteos se expanden en Fini (ver ExpandBblCounts).
+struct BblStats {
+    UINT32 slot;
+    FunctionStats* function;
+    UINT32 counts[ARITH_NUM_TYPES];
+    UINT32 arithTotal;
+    vector<UINT32> ipSites;     // -ip_profile: índices en ipSites del bloque
+
+    BblStats() : slot(INVALID_SLOT), function(nullptr), arithTotal(0) {
+        memset(counts, 0, sizeof(counts));
+    }
+};
+
+// Instrucción aritmética del perfil por IP (-ip_profile). En modo por
+// instrucción cada una tiene su propio slot; en modo -bbl el slot es
+// INVALID_SLOT y su conteo sale de las ejecuciones de sus bloques.
+struct IpSite {
+    UINT32 image;       // índice en ipProfileImages
+    ADDRINT offset;     // desde IMG_LowAddress
+    UINT32 slot;
+    ArithType type;
+    UINT16 destinations;   // IpDestination inyectables (ver ip_profile.h)
+    FunctionStats* function;
+    UINT64 count;
 };
 
-// Contexto de llamada para rastrear jerarquías
-struct CallContext {
-    string functionName;
-    ADDRINT callSite;
+// Llamada indirecta (-icall 1). Cada sitio tiene ICALL_WAYS vías en el
+// arreglo de cada thread, dos slots por vía: destino y conteo. La vía 0 es
+// la más caliente del thread y se resuelve inline; las demás y la tabla
+// lateral del thread (destinos que no entran) en RecordIcallTarget.
+// targets acumula todos los threads al fusionar.
+const UINT32 ICALL_WAYS = 4;
+const UINT32 ICALL_REPORT_TARGETS = 8;
+
+struct IcallSite {
+    ADDRINT address;
+    UINT32 slot;
+    FunctionStats* caller;
+    unordered_map<ADDRINT, UINT64> targets;
+};
+
+// Nodo del árbol de contextos de llamada (CCT). Los nodos se identifican
+// por su índice; el nodo 0 es la raíz. arithCount son las instrucciones
+// aritméticas ejecutadas directamente en ese contexto (exclusivas).
+struct CctNode {
+    UINT32 parent;
+    UINT32 functionId;
     UINT32 depth;
+    UINT64 arithCount;
+};
+
+const UINT32 CCT_ROOT = 0;
+
+// Marco de la pila sombra: nodo del CCT y RSP a la entrada de la función
+// (apunta a la dirección de retorno). Comparar RSP permite desapilar marcos
+// que no vieron su ret (excepciones, longjmp, llamadas en cola).
+struct ShadowFrame {
+    UINT32 node;
+    ADDRINT sp;
+};
+
+// Estado privado de cada thread (Pin TLS). counters es el arreglo de slots
+// del thread; su dirección además se guarda en un registro de herramienta
+// para que las rutinas de análisis lo reciban sin consultar la TLS ni tomar
+// locks. Se fusiona con los demás threads al terminar el thread o en Fini.
+// El CCT también es por thread: solo se reserva memoria al descubrir un
+// contexto nuevo, nunca en el camino de llamada ya conocido.
+struct ThreadData {
+    UINT64* counters;
+    bool liveCounters;                            // counters está en el archivo -live
+    vector<CctNode> cctNodes;
+    unordered_map<UINT64, UINT32> cctChildren;   // (padre << 32 | función) -> nodo
+    vector<ShadowFrame> shadowStack;
+    UINT32 currentNode;
+    UINT64 attributedArith;                       // counters[TOTAL_SLOT] ya atribuido
+    unordered_map<UINT32, unordered_map<ADDRINT, UINT64>> icallOverflow;  // slot del sitio -> destino -> conteo
+    bool merged;
+
+    ThreadData() : counters(nullptr), liveCounters(false), currentNode(CCT_ROOT),
+                   attributedArith(0), merged(false) {}
 };
 
 // ============================================================================
@@ -83,313 +172,1627 @@ struct CallContext {
 // ============================================================================
 
 // Mapa de funciones: address -> FunctionStats
+// (los nodos de std::map no se mueven, los punteros a arithCounts son estables)
 map<ADDRINT, FunctionStats> functionStatsMap;
 
-// Conjunto de funciones de interés (filtro)
-set<string> functionsOfInterest;
+// Bloques básicos instrumentados en modo -bbl (deque: direcciones estables)
+deque<BblStats> bblStatsList;
+
+// Bloques ya vistos: (dirección, tamaño) -> índice en bblStatsList. Evita
+// duplicar registros cuando un trace se vuelve a compilar (ej: al entrar a la ROI)
+map<pair<ADDRINT, USIZE>, UINT32> bblStatsIndex;
+
+// Funciones de interés (filtros -f, -f_regex, -f_exclude) y nombres
+// demangled por dirección de rutina
+FunctionFilter functionFilter;
+SymbolNameCache symbolNames;
+
+// Decisión de los filtros por rutina (dirección de entrada -> estadísticas,
+// nullptr si no interesa), tomada la primera vez que se consulta
+unordered_map<ADDRINT, FunctionStats*> routineDecisions;
+
+// Instrumentación perezosa (-lazy): nada se abre al cargar la imagen.
+// lazySlots memoriza el slot de cada instrucción ya decidida
+// (INVALID_SLOT si no se cuenta)
+bool lazyInstrumentation = false;
+unordered_map<ADDRINT, UINT32> lazySlots;
+
+// Perfil por IP (-ip_profile): sitios y nombres de imagen. ipSiteIndex
+// evita duplicar una IP que aparece en varios bloques
+bool ipProfileEnabled = false;
+deque<IpSite> ipSites;
+unordered_map<ADDRINT, UINT32> ipSiteIndex;
+vector<string> ipProfileImages;
+map<string, UINT32> ipProfileImageIds;
+
+// Llamadas indirectas (-icall): sitios por dirección de la instrucción.
+// icallSites se modifica con threadsLock porque ThreadFini lo recorre
+bool icallEnabled = false;
+deque<IcallSite> icallSites;
+unordered_map<ADDRINT, UINT32> icallSiteIndex;
+
+// Funciones registradas indexadas por FunctionStats::id (para el reporte)
+vector<FunctionStats*> functionsById;
+
+// Slots de contador asignados hasta ahora (capacidad por thread: -slots).
+// Los primeros RESERVED_SLOTS están reservados.
+UINT32 numSlots = RESERVED_SLOTS;
+
+// Suma de los contadores de los threads ya fusionados
+vector<UINT64> mergedCounters;
 
-// Mapa de nombres de funciones: address -> name
-map<ADDRINT, string> functionNames;
+// Todos los threads vistos, para fusionar los que sigan vivos en Fini
+vector<ThreadData*> allThreads;
 
-// Stack de llamadas para rastrear jerarquía
-vector<CallContext> callStack;
+// Protege numSlots, mergedCounters y allThreads (nunca se toma al contar)
+PIN_LOCK threadsLock;
+
+// Clave TLS para ThreadData
+TLS_KEY tlsKey;
+
+// Registro de herramienta con la base del arreglo de contadores del thread
+REG counterBaseReg;
 
 // Mapa para rastrear funciones inline
 map<ADDRINT, set<string>> inlinedFunctionsMap;
 
-// Archivo de salida
+// Región de interés. roiEnabled se fija en main; roiActive lo leen las
+// rutinas de análisis (condición inline de INS_InsertIfCall) y roiDepth
+// permite anidar los marcadores CryptoInjectorRoiBegin/End
+bool roiEnabled = false;
+volatile ADDRINT roiActive = 1;
+std::atomic<INT32> roiDepth(0);
+
+// -roi_start/-roi_stop (nombres como en -f). Con -roi_stop la región es un
+// interruptor: entrar a una rutina la abre y entrar a la otra la cierra.
+// Sin -roi_stop dura lo que el marco más externo de -roi_start: se cierra
+// en el primer ret de ese thread con RSP >= el de la entrada. El marco
+// (thread y RSP) solo cambia bajo roiFrameLock
+FunctionFilter roiStartFilter;
+FunctionFilter roiStopFilter;
+bool roiUntilReturn = false;
+PIN_LOCK roiFrameLock;
+volatile ADDRINT roiFrameSp = 0;
+volatile THREADID roiFrameTid = INVALID_THREADID;
+
+// Granularidad de conteo por bloque: -bbl 1 o cualquier modo de muestreo
+bool bblGranularity = false;
+
+// Muestreo. samplingOn indica si la rebanada actual es instrumentada (se
+// consulta al compilar traces, como roiActive)
+SampleMode sampleMode = SAMPLE_NONE;
+volatile ADDRINT samplingOn = 1;
+UINT64 samplePeriod = 1;
+double sampleMeanGap = 1.0;
+
+// Modo slice: rebanadas instrumentadas medidas por el thread controlador
+struct SliceSample {
+    UINT64 arith;
+    double seconds;
+};
+vector<SliceSample> slices;
+double nativeSeconds = 0;          // tiempo total en rebanadas sin instrumentar
+UINT32 sliceOnMs = 0;
+UINT32 sliceOffMs = 0;
+volatile bool sliceControllerStop = false;
+PIN_THREAD_UID sliceControllerUid;
+
+// Resultado de la estimación (escala aplicada y cota global IC 95%)
+double sampleScale = 1.0;
+double sampleGlobalBound = 0;
+
+// Sitios descartados por los filtros estrictos (estáticos, al instrumentar)
+UINT64 filteredPointerSites = 0;
+UINT64 filteredLoopCounterSites = 0;
+
+// Archivo de salida: reporte de texto (outFile) o perfil estructurado
+// (-format bin|json|csv, profileFile)
 std::ofstream outFile;
+FILE* profileFile = nullptr;
+
+// Contadores en vivo (-live): archivo mapeado con los arreglos de los
+// threads y descriptor del .meta que describe cada slot
+void* liveBase = nullptr;
+LiveStatsHeader* liveHeader = nullptr;
+int liveMetaFd = -1;
 
 // Opciones de línea de comandos
 KNOB<string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool",
     "o", "arithmetic_profile.txt", "Archivo de salida");
 
+KNOB<string> KnobFormat(KNOB_MODE_WRITEONCE, "pintool",
+    "format", "text", "Formato de -o: text, bin, json o csv");
+
 KNOB<string> KnobFunctionFilter(KNOB_MODE_APPEND, "pintool",
     "f", "", "Función a instrumentar (puede especificarse múltiples veces)");
 
+KNOB<string> KnobFunctionRegex(KNOB_MODE_APPEND, "pintool",
+    "f_regex", "", "Expresión regular sobre el nombre de la función (repetible)");
+
+KNOB<string> KnobFunctionExclude(KNOB_MODE_APPEND, "pintool",
+    "f_exclude", "", "No instrumentar funciones cuyo nombre contiene esto (repetible)");
+
 KNOB<BOOL> KnobVerbose(KNOB_MODE_WRITEONCE, "pintool",
     "v", "0", "Modo verbose para debugging");
 
-KNOB<BOOL> KnobTrackCallHierarchy(KNOB_MODE_WRITEONCE, "pintool",
-    "track", "1", "Rastrear jerarquía de llamadas");
+KNOB<BOOL> KnobTrackCallHierarchy(KNOB_MODE_WRITEONCE, "pintool",
+    "track", "1", "Rastrear jerarquía de llamadas");
+
+KNOB<UINT32> KnobTopContexts(KNOB_MODE_WRITEONCE, "pintool",
+    "ctx_top", "20", "Cantidad de contextos de llamada más calientes a reportar");
+
+KNOB<BOOL> KnobBblMode(KNOB_MODE_WRITEONCE, "pintool",
+    "bbl", "0", "Contar por bloque básico (un incremento por ejecución de BBL)");
+
+KNOB<UINT32> KnobMaxSlots(KNOB_MODE_WRITEONCE, "pintool",
+    "slots", "4194304", "Capacidad de slots de contador por thread");
+
+KNOB<BOOL> KnobStrict(KNOB_MODE_WRITEONCE, "pintool",
+    "s", "1", "Modo estricto: solo aritmética del dominio");
+
+KNOB<BOOL> KnobPointerArith(KNOB_MODE_WRITEONCE, "pintool",
+    "p", "0", "Incluir aritmética de punteros en modo estricto");
+
+KNOB<BOOL> KnobLoopCounters(KNOB_MODE_WRITEONCE, "pintool",
+    "c", "0", "Incluir contadores de loop en modo estricto");
+
+KNOB<BOOL> KnobRoi(KNOB_MODE_WRITEONCE, "pintool",
+    "roi", "0", "Contar solo entre CryptoInjectorRoiBegin y CryptoInjectorRoiEnd");
+
+KNOB<string> KnobRoiStart(KNOB_MODE_WRITEONCE, "pintool",
+    "roi_start", "", "Rutina cuya entrada abre la región de interés");
+
+KNOB<string> KnobRoiStop(KNOB_MODE_WRITEONCE, "pintool",
+    "roi_stop", "", "Rutina cuya entrada cierra la región (sin ella, el retorno de -roi_start)");
+
+KNOB<string> KnobSampleMode(KNOB_MODE_WRITEONCE, "pintool",
+    "sample", "", "Muestreo: bbl (1 de cada N ejecuciones de BBL) o slice (rebanadas de tiempo)");
+
+KNOB<UINT64> KnobSamplePeriod(KNOB_MODE_WRITEONCE, "pintool",
+    "sample_period", "1000", "Modo bbl: período medio N entre muestras");
+
+KNOB<UINT32> KnobMaxSlowdown(KNOB_MODE_WRITEONCE, "pintool",
+    "max_slowdown", "5", "Modo slice: slowdown objetivo respecto de la ejecución nativa");
+
+KNOB<UINT32> KnobExactSlowdown(KNOB_MODE_WRITEONCE, "pintool",
+    "exact_slowdown", "40", "Modo slice: slowdown medido del modo exacto (-bbl 1)");
+
+KNOB<UINT32> KnobSliceMs(KNOB_MODE_WRITEONCE, "pintool",
+    "slice_ms", "20", "Modo slice: duración de cada rebanada instrumentada (ms)");
+
+KNOB<string> KnobIpProfile(KNOB_MODE_WRITEONCE, "pintool",
+    "ip_profile", "", "Archivo binario con conteos dinámicos por IP");
+
+KNOB<string> KnobLive(KNOB_MODE_WRITEONCE, "pintool",
+    "live", "", "Archivo mapeado con los contadores en vivo (lector: statview)");
+
+KNOB<UINT32> KnobLiveThreads(KNOB_MODE_WRITEONCE, "pintool",
+    "live_threads", "64", "Threads con contadores en el archivo -live (el resto, en memoria)");
+
+KNOB<BOOL> KnobIcall(KNOB_MODE_WRITEONCE, "pintool",
+    "icall", "0", "Histograma de destinos de cada llamada indirecta, por función llamadora");
+
+KNOB<BOOL> KnobLazy(KNOB_MODE_WRITEONCE, "pintool",
+    "lazy", "0", "Instrumentar cada rutina al compilar su primer trace, no al cargar la imagen");
+
+KNOB<BOOL> KnobIncludeLibraries(KNOB_MODE_WRITEONCE, "pintool",
+    "l", "0", "Incluir bibliotecas dinámicas en la instrumentación");
+
+// ============================================================================
+// FUNCIONES AUXILIARES
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Filtros del modo estricto (-s, -p, -c)
+// ----------------------------------------------------------------------------
+
+// Ventanas de búsqueda hacia adelante para el análisis de operandos
+const UINT32 POINTER_USE_WINDOW = 16;
+const UINT32 LOOP_BRANCH_WINDOW = 8;
+
+// Solo la aritmética entera escalar puede ser de infraestructura; SIMD,
+// FP y multi-precisión se consideran siempre del dominio
+bool IsInfrastructureCandidate(ArithType type) {
+    return type == ARITH_ADD || type == ARITH_SUB ||
+           type == ARITH_INC || type == ARITH_DEC;
+}
+
+// Registro destino (operando 0 escrito), normalizado al registro completo
+REG DestinationRegister(INS ins) {
+    if (INS_OperandCount(ins) == 0 ||
+        !INS_OperandIsReg(ins, 0) || !INS_OperandWritten(ins, 0)) {
+        return REG_INVALID();
+    }
+    return REG_FullRegName(INS_OperandReg(ins, 0));
+}
+
+// ¿Usa la instrucción a reg como base o índice de algún operando de memoria?
+bool UsesAsAddressRegister(INS ins, REG reg) {
+    for (UINT32 i = 0; i < INS_OperandCount(ins); i++) {
+        if (!INS_OperandIsMemory(ins, i)) {
+            continue;
+        }
+        REG base = INS_OperandMemoryBaseReg(ins, i);
+        REG index = INS_OperandMemoryIndexReg(ins, i);
+        if ((REG_valid(base) && REG_FullRegName(base) == reg) ||
+            (REG_valid(index) && REG_FullRegName(index) == reg)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Aritmética de punteros: destino RSP/RBP, o un registro que se usa como
+// base/índice de memoria antes de ser redefinido (ej: add rax, 8; mov [rax], ...)
+bool IsPointerArithmetic(INS ins) {
+    REG dst = DestinationRegister(ins);
+    if (!REG_valid(dst)) {
+        return false;
+    }
+    if (dst == REG_STACK_PTR || dst == REG_GBP) {
+        return true;
+    }
+
+    INS next = INS_Next(ins);
+    for (UINT32 i = 0; i < POINTER_USE_WINDOW && INS_Valid(next); i++, next = INS_Next(next)) {
+        if (UsesAsAddressRegister(next, dst)) {
+            return true;
+        }
+        if (INS_IsControlFlow(next) ||
+            (INS_RegWContain(next, dst) && !INS_RegRContain(next, dst))) {
+            break;
+        }
+    }
+    return false;
+}
+
+// Contador de loop: inc/dec/add/sub con inmediato sobre un registro cuyo
+// valor (directamente por flags o vía cmp/test) decide un salto condicional
+// hacia atrás (ej: inc rcx; cmp rcx, rdx; jb loop)
+bool IsLoopCounter(INS ins) {
+    REG dst = DestinationRegister(ins);
+    if (!REG_valid(dst) || !REG_is_gr(dst)) {
+        return false;
+    }
+
+    OPCODE opcode = INS_Opcode(ins);
+    if ((opcode == XED_ICLASS_ADD || opcode == XED_ICLASS_SUB) &&
+        !(INS_OperandCount(ins) > 1 && INS_OperandIsImmediate(ins, 1))) {
+        return false;
+    }
+
+    bool flagsFromCounter = true;
+    INS next = INS_Next(ins);
+    for (UINT32 i = 0; i < LOOP_BRANCH_WINDOW && INS_Valid(next); i++, next = INS_Next(next)) {
+        if (INS_Category(next) == XED_CATEGORY_COND_BR) {
+            return flagsFromCounter && INS_IsDirectControlFlow(next) &&
+                   INS_DirectControlFlowTargetAddress(next) <= INS_Address(ins);
+        }
+        if (INS_IsControlFlow(next) || INS_RegWContain(next, dst)) {
+            return false;
+        }
+
+        OPCODE nextOpcode = INS_Opcode(next);
+        if ((nextOpcode == XED_ICLASS_CMP || nextOpcode == XED_ICLASS_TEST) &&
+            INS_RegRContain(next, dst)) {
+            flagsFromCounter = true;
+        } else if (INS_RegWContain(next, REG_RFLAGS)) {
+            flagsFromCounter = false;
+        }
+    }
+    return false;
+}
+
+// Clasificar y aplicar los filtros estrictos. Las instrucciones filtradas
+// devuelven ARITH_UNKNOWN y no reciben ninguna llamada de análisis.
+ArithType ClassifyForCounting(INS ins) {
+    ArithType type = ClassifyArithmeticInstruction(ins);
+    if (type == ARITH_UNKNOWN || !KnobStrict.Value() || !IsInfrastructureCandidate(type)) {
+        return type;
+    }
+
+    if (!KnobPointerArith.Value() && IsPointerArithmetic(ins)) {
+        filteredPointerSites++;
+        return ARITH_UNKNOWN;
+    }
+    if (!KnobLoopCounters.Value() && IsLoopCounter(ins)) {
+        filteredLoopCounterSites++;
+        return ARITH_UNKNOWN;
+    }
+    return type;
+}
+
+// Obtener el nombre demangled de una rutina (calculado una vez por dirección)
+const string& GetDemangledName(RTN rtn) {
+    return symbolNames.Demangled(RTN_Address(rtn), RTN_Name(rtn));
+}
+
+// Filtros -f/-f_regex/-f_exclude sobre el nombre mangled y el demangled.
+// Sin filtros no se demangla nada
+bool IsFunctionOfInterest(RTN rtn, const string& rtnName) {
+    if (functionFilter.Empty()) {
+        return true;
+    }
+    return functionFilter.Matches(rtnName, GetDemangledName(rtn));
+}
+
+// Agregar una línea al .meta de -live. Un write() por línea: un lector
+// concurrente nunca ve una línea a medias salvo la última
+VOID LiveMeta(const string& line) {
+    if (liveMetaFd < 0) {
+        return;
+    }
+    string record = line + "\n";
+    if (write(liveMetaFd, record.data(), record.size()) != static_cast<ssize_t>(record.size())) {
+        std::cerr << "Advertencia: no se pudo escribir " << KnobLive.Value() << ".meta" << std::endl;
+        close(liveMetaFd);
+        liveMetaFd = -1;
+    }
+}
+
+// Reservar n slots contiguos de contador. Se llama en tiempo de
+// instrumentación; devuelve INVALID_SLOT si se agotó la capacidad.
+UINT32 AllocateSlots(UINT32 n) {
+    PIN_GetLock(&threadsLock, PIN_ThreadId() + 1);
+
+    UINT32 first = INVALID_SLOT;
+    if (numSlots + n <= KnobMaxSlots.Value()) {
+        first = numSlots;
+        numSlots += n;
+        if (liveHeader != nullptr) {
+            liveHeader->numSlots = numSlots;
+        }
+    } else {
+        static bool warned = false;
+        if (!warned) {
+            std::cerr << "Advertencia: capacidad de slots agotada (-slots "
+                      << KnobMaxSlots.Value() << "), conteos incompletos" << std::endl;
+            warned = true;
+        }
+    }
+
+    PIN_ReleaseLock(&threadsLock);
+    return first;
+}
+
+// Registrar (o encontrar) el sitio de una instrucción en el perfil por IP
+UINT32 RegisterIpSite(IMG img, INS ins, ArithType type, FunctionStats* function) {
+    ADDRINT address = INS_Address(ins);
+    auto known = ipSiteIndex.find(address);
+    if (known != ipSiteIndex.end()) {
+        return known->second;
+    }
+
+    string imgName = IMG_Valid(img) ? IMG_Name(img) : "";
+    auto image = ipProfileImageIds.find(imgName);
+    if (image == ipProfileImageIds.end()) {
+        image = ipProfileImageIds.emplace(imgName, ipProfileImages.size()).first;
+        ipProfileImages.push_back(imgName);
+    }
+
+    IpSite site;
+    site.image = image->second;
+    site.offset = address - (IMG_Valid(img) ? IMG_LowAddress(img) : 0);
+    site.slot = INVALID_SLOT;
+    site.type = type;
+    site.destinations = (HasInjectableRegister(ins) ? IP_DEST_REG : 0) |
+                        (HasInjectableWrite(ins) ? IP_DEST_MEM : 0);
+    site.function = function;
+    site.count = 0;
+
+    UINT32 index = ipSites.size();
+    ipSites.push_back(site);
+    ipSiteIndex[address] = index;
+    return index;
+}
+
+// ============================================================================
+// FUNCIONES DE ANÁLISIS (CALLBACKS)
+// ============================================================================
+
+// Callback de conteo: incrementa un slot (función/tipo o ejecuciones de un
+// BBL) en el arreglo privado del thread, que llega en el registro de
+// herramienta. Sin ramas, búsquedas ni locks para que Pin pueda hacerlo inline.
+// Con TRACK (-track 1) además suma al total del thread, que FunctionEntry y
+// FunctionReturn reparten entre los contextos de llamada. La instancia se
+// elige al instrumentar (ver SelectAnalysisRoutines), nunca en ejecución.
+template <bool TRACK>
+VOID PIN_FAST_ANALYSIS_CALL IncrementSlot(UINT64* counters, UINT32 slot) {
+    counters[slot]++;
+    if (TRACK) {
+        counters[TOTAL_SLOT]++;
+    }
+}
+
+// Por bloque con -track 1 o -sample slice: suma al total las aritméticas
+// del bloque
+VOID PIN_FAST_ANALYSIS_CALL IncrementBblTracked(UINT64* counters, UINT32 slot, UINT32 arith) {
+    counters[slot]++;
+    counters[TOTAL_SLOT] += arith;
+}
+
+// Modo -sample bbl: condición inline, una cuenta regresiva por thread
+ADDRINT PIN_FAST_ANALYSIS_CALL SampleCountdown(UINT64* counters) {
+    return --counters[SAMPLE_COUNTDOWN_SLOT] == 0;
+}
+
+// Ejecución muestreada: registrar la muestra y sortear la próxima distancia
+// en [N - floor(N/2), N + floor(N/2)] (xorshift) para no alinearse con los
+// loops. La media es exactamente N, la misma escala que TOTAL_SLOT acá y que
+// sampleMeanGap en ExpandBblCounts y statview
+VOID PIN_FAST_ANALYSIS_CALL RecordBblSample(UINT64* counters, UINT32 slot, UINT32 arith) {
+    counters[slot]++;
+    counters[TOTAL_SLOT] += arith * samplePeriod;
+
+    UINT64 x = counters[SAMPLE_RNG_SLOT];
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    counters[SAMPLE_RNG_SLOT] = x;
+    UINT64 half = samplePeriod / 2;
+    counters[SAMPLE_COUNTDOWN_SLOT] = samplePeriod - half + x % (2 * half + 1);
+}
+
+// Condición inline para INS_InsertIfCall: ¿estamos dentro de la ROI?
+ADDRINT PIN_FAST_ANALYSIS_CALL RoiIsActive() {
+    return roiActive;
+}
+
+// -icall: condición inline. Si el destino es el de la vía 0 cuenta sin
+// ramas y no llama a RecordIcallTarget. Con ROI, fuera de la región no
+// cuenta ni llama.
+template <bool ROI>
+ADDRINT PIN_FAST_ANALYSIS_CALL IcallHit(UINT64* counters, UINT32 slot, ADDRINT target) {
+    ADDRINT active = ROI ? roiActive : 1;
+    ADDRINT hit = counters[slot] == target;
+    counters[slot + 1] += hit & active;
+    return (hit ^ 1) & active;
+}
+
+// -icall: destino que no está en la vía 0. Ocupa una vía libre o cuenta en
+// la suya (y la sube a la vía 0 si ya es la más caliente); si no hay lugar
+// va a la tabla lateral del thread, y cuando supera a la vía más fría
+// intercambian lugar: las vías guardan siempre los destinos más frecuentes
+VOID PIN_FAST_ANALYSIS_CALL RecordIcallTarget(UINT64* counters, UINT32 slot, ADDRINT target,
+                                               THREADID tid) {
+    UINT64* ways = counters + slot;
+    UINT32 coldest = 0;
+    for (UINT32 w = 0; w < ICALL_WAYS; w++) {
+        UINT64* way = ways + 2 * w;
+        if (way[0] == target || way[1] == 0) {
+            way[0] = target;
+            way[1]++;
+            if (w > 0 && way[1] > ways[1]) {
+                std::swap(way[0], ways[0]);
+                std::swap(way[1], ways[1]);
+            }
+            return;
+        }
+        if (way[1] < ways[2 * coldest + 1]) {
+            coldest = w;
+        }
+    }
+
+    ThreadData* td = static_cast<ThreadData*>(PIN_GetThreadData(tlsKey, tid));
+    unordered_map<ADDRINT, UINT64>& overflow = td->icallOverflow[slot];
+    UINT64 count = ++overflow[target];
+
+    UINT64* cold = ways + 2 * coldest;
+    if (count > cold[1]) {
+        overflow.erase(target);
+        overflow[cold[0]] += cold[1];
+        cold[0] = target;
+        cold[1] = count;
+    }
+}
+
+// Cambiar el estado de la ROI. En modo -bbl los contadores se insertan solo
+// en traces compilados dentro de la región, así que se descarta el code
+// cache para recompilar: fuera de la ROI el código corre sin análisis.
+VOID SetRoiActive(bool active) {
+    roiActive = active;
+    if (KnobVerbose.Value()) {
+        std::cerr << (active ? "ROI: inicio" : "ROI: fin") << std::endl;
+    }
+    if (bblGranularity) {
+        PIN_RemoveInstrumentation();
+    }
+}
+
+// Entrada y salida de la región por los marcadores (pares balanceados)
+VOID RoiEnter() {
+    if (roiDepth.fetch_add(1) == 0) {
+        SetRoiActive(true);
+    }
+}
+
+VOID RoiExit() {
+    INT32 depth = roiDepth.load();
+    while (depth > 0 && !roiDepth.compare_exchange_weak(depth, depth - 1)) {
+    }
+    if (depth == 1) {
+        SetRoiActive(false);
+    }
+}
+
+// -roi_start con -roi_stop: abrir y cerrar sin contar entradas, así varias
+// llamadas a Encrypt (o a otras rutinas que encajan) no dejan la región
+// abierta para siempre
+VOID RoiSet() {
+    if (!roiActive) {
+        SetRoiActive(true);
+    }
+}
+
+VOID RoiClear() {
+    if (roiActive) {
+        SetRoiActive(false);
+    }
+}
+
+// -roi_start sin -roi_stop: abrir la región y recordar el marco de entrada.
+// Las entradas anidadas o recursivas no cambian nada, salvo que el marco
+// recordado ya esté muerto (una excepción lo desapiló sin pasar por un ret)
+VOID RoiFrameEnter(ADDRINT sp, THREADID tid) {
+    PIN_GetLock(&roiFrameLock, tid + 1);
+    if (!roiActive || (tid == roiFrameTid && sp >= roiFrameSp)) {
+        roiFrameTid = tid;
+        roiFrameSp = sp;
+        if (!roiActive) {
+            SetRoiActive(true);
+        }
+    }
+    PIN_ReleaseLock(&roiFrameLock);
+}
+
+// Condición inline en cada ret: ¿se desapila el marco de -roi_start? En el
+// ret RSP apunta a la dirección de retorno, igual que a la entrada, así que
+// también cierra tras una llamada en cola o una excepción que saltó el ret.
+// Otros threads tienen su propia pila, así que solo cuenta el thread dueño
+// del marco. La condición lee thread y RSP sin lock: si otro thread cambia
+// el marco a la vez, RoiFrameReturn vuelve a verificar bajo roiFrameLock
+ADDRINT PIN_FAST_ANALYSIS_CALL RoiFrameReturning(ADDRINT sp, THREADID tid) {
+    return roiActive & (tid == roiFrameTid) & (sp >= roiFrameSp);
+}
+
+VOID RoiFrameReturn(ADDRINT sp, THREADID tid) {
+    PIN_GetLock(&roiFrameLock, tid + 1);
+    if (roiActive && tid == roiFrameTid && sp >= roiFrameSp) {
+        roiFrameTid = INVALID_THREADID;
+        SetRoiActive(false);
+    }
+    PIN_ReleaseLock(&roiFrameLock);
+}
+
+// Atribuir al contexto actual lo contado desde el último cambio de contexto
+inline VOID AttributeToCurrentContext(ThreadData* td) {
+    UINT64 total = td->counters[TOTAL_SLOT];
+    td->cctNodes[td->currentNode].arithCount += total - td->attributedArith;
+    td->attributedArith = total;
+}
+
+// Desapilar los marcos cuya función ya retornó: todo marco con RSP de
+// entrada <= sp está muerto si ahora se entra o retorna con ese sp
+inline VOID UnwindShadowStack(ThreadData* td, ADDRINT sp) {
+    while (!td->shadowStack.empty() && td->shadowStack.back().sp <= sp) {
+        td->shadowStack.pop_back();
+    }
+    td->currentNode = td->shadowStack.empty() ? CCT_ROOT : td->shadowStack.back().node;
+}
+
+// Buscar (o crear la primera vez) el hijo de parent para la función dada
+UINT32 FindOrCreateCctChild(ThreadData* td, UINT32 parent, UINT32 functionId) {
+    UINT64 key = (static_cast<UINT64>(parent) << 32) | functionId;
+    auto it = td->cctChildren.find(key);
+    if (it != td->cctChildren.end()) {
+        return it->second;
+    }
+
+    UINT32 node = td->cctNodes.size();
+    td->cctNodes.push_back({parent, functionId, td->cctNodes[parent].depth + 1, 0});
+    td->cctChildren.emplace(key, node);
+    return node;
+}
+
+// Callback para entrada de función (sp = RSP a la entrada). Fuera de la
+// ROI no se llama: la condición va inline en INS_InsertIfCall
+template <bool VERBOSE>
+VOID FunctionEntry(FunctionStats* stats, ADDRINT sp, THREADID tid) {
+    ThreadData* td = static_cast<ThreadData*>(PIN_GetThreadData(tlsKey, tid));
+
+    AttributeToCurrentContext(td);
+    UnwindShadowStack(td, sp);
+
+    UINT32 node = FindOrCreateCctChild(td, td->currentNode, stats->id);
+    td->shadowStack.push_back({node, sp});
+    td->currentNode = node;
+
+    if (VERBOSE) {
+        std::cerr << "[T" << tid << "] " << string(td->cctNodes[node].depth * 2, ' ')
+                  << "-> " << stats->name
+                  << " @ 0x" << std::hex << stats->address << std::dec
+                  << std::endl;
+    }
+}
+
+// Callback antes de cada ret de una función instrumentada (sp = RSP en el
+// ret, que coincide con el RSP de entrada del marco que retorna)
+VOID FunctionReturn(ADDRINT sp, THREADID tid) {
+    ThreadData* td = static_cast<ThreadData*>(PIN_GetThreadData(tlsKey, tid));
+
+    AttributeToCurrentContext(td);
+    UnwindShadowStack(td, sp);
+}
+
+// Rutinas de análisis elegidas una vez según la configuración (-track, -v,
+// -roi; se llama después de fijar roiEnabled). Los filtros (-s, -p, -c) y la granularidad (-bbl, -sample) ya se
+// resuelven al instrumentar: deciden qué se inserta, no qué se ejecuta.
+struct AnalysisRoutines {
+    AFUNPTR arithCounter;       // por instrucción
+    AFUNPTR functionEntry;
+    AFUNPTR icallHit;
+};
+AnalysisRoutines analysis;
+
+VOID SelectAnalysisRoutines() {
+    bool track = KnobTrackCallHierarchy.Value();
+    analysis.arithCounter = track ? (AFUNPTR)IncrementSlot<true> : (AFUNPTR)IncrementSlot<false>;
+    analysis.functionEntry = KnobVerbose.Value() ? (AFUNPTR)FunctionEntry<true>
+                                                 : (AFUNPTR)FunctionEntry<false>;
+    analysis.icallHit = roiEnabled ? (AFUNPTR)IcallHit<true> : (AFUNPTR)IcallHit<false>;
+}
+
+// ============================================================================
+// INSTRUMENTACIÓN
+// ============================================================================
+
+// Insertar el contador de una instrucción. Con ROI queda condicionado a
+// roiActive con INS_InsertIfCall: fuera de la región solo corre la
+// condición inline, nunca el incremento.
+VOID InsertArithCounter(INS ins, AFUNPTR counter, UINT32 slot) {
+    if (roiEnabled) {
+        INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)RoiIsActive,
+                        IARG_FAST_ANALYSIS_CALL,
+                        IARG_END);
+        INS_InsertThenCall(ins, IPOINT_BEFORE, counter,
+                          IARG_FAST_ANALYSIS_CALL,
+                          IARG_REG_VALUE, counterBaseReg,
+                          IARG_UINT32, slot,
+                          IARG_END);
+    } else {
+        INS_InsertCall(ins, IPOINT_BEFORE, counter,
+                      IARG_FAST_ANALYSIS_CALL,
+                      IARG_REG_VALUE, counterBaseReg,
+                      IARG_UINT32, slot,
+                      IARG_END);
+    }
+}
+
+// Enganchar los marcadores de ROI y las rutinas de -roi_start/-roi_stop.
+// Se hace en todas las imágenes, sin aplicar los filtros -f ni -l.
+VOID InstrumentRoiMarkers(RTN rtn) {
+    string rtnName = RTN_Name(rtn);
+
+    bool isBegin = rtnName == CRYPTO_INJECTOR_ROI_BEGIN_NAME;
+    bool isEnd = rtnName == CRYPTO_INJECTOR_ROI_END_NAME;
+    bool isStart = !roiStartFilter.Empty() &&
+                   roiStartFilter.Matches(rtnName, GetDemangledName(rtn));
+    bool isStop = !roiStopFilter.Empty() &&
+                  roiStopFilter.Matches(rtnName, GetDemangledName(rtn));
+    if (!isBegin && !isEnd && !isStart && !isStop) {
+        return;
+    }
+
+    if (KnobVerbose.Value()) {
+        std::cerr << "Marcador de ROI: " << rtnName << std::endl;
+    }
+
+    RTN_Open(rtn);
+    if (isBegin) {
+        RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)RoiEnter, IARG_END);
+    }
+    if (isEnd) {
+        RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)RoiExit, IARG_END);
+    }
+    if (isStart && roiUntilReturn) {
+        RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)RoiFrameEnter,
+                      IARG_REG_VALUE, REG_STACK_PTR,
+                      IARG_THREAD_ID,
+                      IARG_END);
+    } else if (isStart) {
+        RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)RoiSet, IARG_END);
+    }
+    if (isStop) {
+        RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)RoiClear, IARG_END);
+    }
+    RTN_Close(rtn);
+}
+
+// Sin -roi_stop: fin de la región en los ret (ver RoiFrameReturning). Se
+// inserta en todo trace, también fuera de la región y de los filtros
+VOID InsertRoiFrameCheck(INS ins) {
+    INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)RoiFrameReturning,
+                    IARG_FAST_ANALYSIS_CALL,
+                    IARG_REG_VALUE, REG_STACK_PTR,
+                    IARG_THREAD_ID,
+                    IARG_END);
+    INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)RoiFrameReturn,
+                      IARG_REG_VALUE, REG_STACK_PTR,
+                      IARG_THREAD_ID,
+                      IARG_END);
+}
+
+// Registrar una rutina la primera vez que se la consulta y memorizar la
+// decisión de los filtros. Devuelve nullptr si la rutina no interesa.
+// No necesita RTN_Open: sirve tanto al recorrer la imagen como al
+// compilar un trace (-lazy, -bbl).
+FunctionStats* LookupFunction(RTN rtn) {
+    ADDRINT rtnAddr = RTN_Address(rtn);
+    auto known = routineDecisions.find(rtnAddr);
+    if (known != routineDecisions.end()) {
+        return known->second;
+    }
+
+    string rtnName = RTN_Name(rtn);
+    IMG img = SEC_Img(RTN_Sec(rtn));
+
+    // Filtrar bibliotecas si es necesario y por funciones de interés
+    if ((!KnobIncludeLibraries.Value() && IMG_Type(img) == IMG_TYPE_SHAREDLIB) ||
+        !IsFunctionOfInterest(rtn, rtnName)) {
+        routineDecisions[rtnAddr] = nullptr;
+        return nullptr;
+    }
+
+    // Inicializar estadísticas de la función
+    FunctionStats& stats = functionStatsMap[rtnAddr];
+    stats.name = rtnName;
+    stats.address = rtnAddr;
+    stats.id = functionsById.size();
+    stats.firstSlot = AllocateSlots(ARITH_NUM_TYPES);
+    functionsById.push_back(&stats);
+    if (stats.firstSlot != INVALID_SLOT) {
+        LiveMeta("F " + decstr(stats.id) + " " + decstr(stats.firstSlot) + " " + rtnName);
+    }
+
+    if (KnobVerbose.Value()) {
+        std::cerr << "Instrumentando función: " << rtnName
+                  << " @ 0x" << std::hex << rtnAddr << std::dec
+                  << " en " << IMG_Name(img) << std::endl;
+    }
+
+    routineDecisions[rtnAddr] = &stats;
+    return &stats;
+}
+
+// Slot que cuenta una instrucción de la función, o INVALID_SLOT si no se
+// cuenta (no aritmética, filtrada o sin capacidad)
+UINT32 ArithSlot(INS ins, IMG img, FunctionStats& stats) {
+    ArithType type = ClassifyForCounting(ins);
+    if (type == ARITH_UNKNOWN) {
+        return INVALID_SLOT;
+    }
+
+    // Con -ip_profile cada instrucción cuenta en su propio slot; los
+    // conteos por tipo de la función se reconstruyen en ExpandIpCounts
+    if (!ipProfileEnabled) {
+        return stats.firstSlot + type;
+    }
+    IpSite& site = ipSites[RegisterIpSite(img, ins, type, &stats)];
+    if (site.slot == INVALID_SLOT) {
+        site.slot = AllocateSlots(1);
+        if (site.slot != INVALID_SLOT) {
+            LiveMeta("S " + decstr(site.slot) + " " + decstr(stats.id) + " " + decstr(type));
+        }
+    }
+    return site.slot;
+}
+
+// Entrada y retorno de función (-track 1). Con ROI quedan condicionados a
+// roiActive igual que los contadores, así los callbacks no consultan nada
+VOID InsertFunctionEntry(INS ins, FunctionStats& stats) {
+    if (roiEnabled) {
+        INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)RoiIsActive,
+                        IARG_FAST_ANALYSIS_CALL,
+                        IARG_END);
+        INS_InsertThenCall(ins, IPOINT_BEFORE, analysis.functionEntry,
+                          IARG_PTR, &stats,
+                          IARG_REG_VALUE, REG_STACK_PTR,
+                          IARG_THREAD_ID,
+                          IARG_END);
+    } else {
+        INS_InsertCall(ins, IPOINT_BEFORE, analysis.functionEntry,
+                      IARG_PTR, &stats,
+                      IARG_REG_VALUE, REG_STACK_PTR,
+                      IARG_THREAD_ID,
+                      IARG_END);
+    }
+}
+
+VOID InsertFunctionReturn(INS ins) {
+    if (roiEnabled) {
+        INS_InsertIfCall(ins, IPOINT_BEFORE, (AFUNPTR)RoiIsActive,
+                        IARG_FAST_ANALYSIS_CALL,
+                        IARG_END);
+        INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)FunctionReturn,
+                          IARG_REG_VALUE, REG_STACK_PTR,
+                          IARG_THREAD_ID,
+                          IARG_END);
+    } else {
+        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)FunctionReturn,
+                      IARG_REG_VALUE, REG_STACK_PTR,
+                      IARG_THREAD_ID,
+                      IARG_END);
+    }
+}
+
+// Instrumentar una rutina (función)
+VOID InstrumentRoutine(RTN rtn, VOID *v) {
+    FunctionStats* found = LookupFunction(rtn);
+    if (found == nullptr) {
+        return;
+    }
+    FunctionStats& stats = *found;
+    IMG img = SEC_Img(RTN_Sec(rtn));
+
+    RTN_Open(rtn);
+
+    // Instrumentar entrada de función (primera instrucción, como
+    // RTN_InsertCall). Las salidas se detectan en cada ret (IPOINT_AFTER no
+    // ve excepciones ni llamadas en cola)
+    bool track = KnobTrackCallHierarchy.Value();
+    if (track && INS_Valid(RTN_InsHead(rtn))) {
+        InsertFunctionEntry(RTN_InsHead(rtn), stats);
+    }
+
+    // En modo -bbl el conteo se instrumenta por bloque en InstrumentTrace
+    bool countHere = !bblGranularity && stats.firstSlot != INVALID_SLOT;
+
+    // Instrumentar cada instrucción en la rutina
+    for (INS ins = RTN_InsHead(rtn); INS_Valid(ins); ins = INS_Next(ins)) {
+        if (track && INS_IsRet(ins)) {
+            InsertFunctionReturn(ins);
+        }
+
+        if (!countHere) {
+            continue;
+        }
+
+        UINT32 slot = ArithSlot(ins, img, stats);
+        if (slot != INVALID_SLOT) {
+            InsertArithCounter(ins, analysis.arithCounter, slot);
+        }
+    }
+
+    RTN_Close(rtn);
+}
+
+// Modo -lazy: los marcadores de ROI se buscan por nombre en lugar de
+// recorrer la imagen; solo -roi_start/-roi_stop (subcadenas) necesitan
+// mirar el nombre de cada rutina, sin abrirlas
+VOID InstrumentRoiMarkersByName(IMG img) {
+    if (!KnobRoiStart.Value().empty() || !KnobRoiStop.Value().empty()) {
+        for (SEC sec = IMG_SecHead(img); SEC_Valid(sec); sec = SEC_Next(sec)) {
+            for (RTN rtn = SEC_RtnHead(sec); RTN_Valid(rtn); rtn = RTN_Next(rtn)) {
+                InstrumentRoiMarkers(rtn);
+            }
+        }
+        return;
+    }
+
+    const char* markers[] = {CRYPTO_INJECTOR_ROI_BEGIN_NAME, CRYPTO_INJECTOR_ROI_END_NAME};
+    for (const char* name : markers) {
+        RTN rtn = RTN_FindByName(img, name);
+        if (RTN_Valid(rtn)) {
+            InstrumentRoiMarkers(rtn);
+        }
+    }
+}
+
+// Instrumentar imágenes cargadas (para manejar bibliotecas dinámicas)
+VOID ImageLoad(IMG img, VOID *v) {
+    if (KnobVerbose.Value()) {
+        std::cerr << "Cargando imagen: " << IMG_Name(img)
+                  << " @ 0x" << std::hex << IMG_LowAddress(img) << std::dec
+                  << std::endl;
+    }
+
+    // Con -lazy las rutinas se instrumentan al compilar sus traces
+    if (lazyInstrumentation) {
+        if (roiEnabled) {
+            InstrumentRoiMarkersByName(img);
+        }
+        return;
+    }
+
+    // Instrumentar todas las rutinas en la imagen
+    for (SEC sec = IMG_SecHead(img); SEC_Valid(sec); sec = SEC_Next(sec)) {
+        for (RTN rtn = SEC_RtnHead(sec); RTN_Valid(rtn); rtn = RTN_Next(rtn)) {
+            if (roiEnabled) {
+                InstrumentRoiMarkers(rtn);
+            }
+            InstrumentRoutine(rtn, v);
+        }
+    }
+}
+
+// Insertar el contador de ejecuciones de un bloque ya registrado
+VOID InsertBblCounter(BBL bbl, const BblStats& bblStats) {
+    if (sampleMode == SAMPLE_BBL) {
+        BBL_InsertIfCall(bbl, IPOINT_BEFORE, (AFUNPTR)SampleCountdown,
+                        IARG_FAST_ANALYSIS_CALL,
+                        IARG_REG_VALUE, counterBaseReg,
+                        IARG_END);
+        BBL_InsertThenCall(bbl, IPOINT_BEFORE, (AFUNPTR)RecordBblSample,
+                          IARG_FAST_ANALYSIS_CALL,
+                          IARG_REG_VALUE, counterBaseReg,
+                          IARG_UINT32, bblStats.slot,
+                          IARG_UINT32, bblStats.arithTotal,
+                          IARG_END);
+    } else if (KnobTrackCallHierarchy.Value() || sampleMode == SAMPLE_SLICE) {
+        BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR)IncrementBblTracked,
+                      IARG_FAST_ANALYSIS_CALL,
+                      IARG_REG_VALUE, counterBaseReg,
+                      IARG_UINT32, bblStats.slot,
+                      IARG_UINT32, bblStats.arithTotal,
+                      IARG_END);
+    } else {
+        BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR)IncrementSlot<false>,
+                      IARG_FAST_ANALYSIS_CALL,
+                      IARG_REG_VALUE, counterBaseReg,
+                      IARG_UINT32, bblStats.slot,
+                      IARG_END);
+    }
+}
+
+// Modo -bbl: calcular el histograma aritmético de cada bloque e insertar
+// un único contador de ejecuciones por bloque
+VOID InstrumentBbl(BBL bbl) {
+    // Fuera de la ROI o de una rebanada muestreada el trace se compila sin
+    // contadores (ver SetRoiActive y SliceController)
+    if (!roiActive || !samplingOn) {
+        return;
+    }
+
+    RTN rtn = RTN_FindByAddress(BBL_Address(bbl));
+    if (!RTN_Valid(rtn)) {
+        return;
+    }
+
+    // Solo funciones de interés (filtros aplicados una vez por rutina)
+    FunctionStats* function = LookupFunction(rtn);
+    if (function == nullptr) {
+        return;
+    }
+
+    // Bloque ya registrado en otro trace: reutilizar su slot
+    auto key = std::make_pair(BBL_Address(bbl), BBL_Size(bbl));
+    auto known = bblStatsIndex.find(key);
+    if (known != bblStatsIndex.end()) {
+        InsertBblCounter(bbl, bblStatsList[known->second]);
+        return;
+    }
+
+    BblStats bblStats;
+    bblStats.function = function;
+    UINT32 arithInBbl = 0;
+
+    for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+        ArithType type = ClassifyForCounting(ins);
+        if (type != ARITH_UNKNOWN) {
+            bblStats.counts[type]++;
+            arithInBbl++;
+            if (ipProfileEnabled) {
+                bblStats.ipSites.push_back(RegisterIpSite(SEC_Img(RTN_Sec(rtn)), ins, type, bblStats.function));
+            }
+        }
+    }
+
+    if (arithInBbl == 0) {
+        return;
+    }
+
+    bblStats.slot = AllocateSlots(1);
+    if (bblStats.slot == INVALID_SLOT) {
+        return;
+    }
+
+    bblStats.arithTotal = arithInBbl;
+    if (liveMetaFd >= 0) {
+        string line = "B " + decstr(bblStats.slot) + " " + decstr(bblStats.function->id);
+        for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+            line += " " + decstr(bblStats.counts[t]);
+        }
+        LiveMeta(line);
+    }
+    bblStatsIndex[key] = bblStatsList.size();
+    bblStatsList.push_back(bblStats);
+    InsertBblCounter(bbl, bblStats);
+}
+
+// Modo -lazy: la rutina del bloque se resuelve y se decide recién cuando
+// Pin compila un trace suyo; las rutinas que nunca corren no se abren. La
+// entrada se instrumenta en la instrucción de RTN_Address (lo que hace
+// RTN_InsertCall) y el slot de cada instrucción se memoriza por dirección,
+// así un trace recompilado no vuelve a clasificar ni a reservar slots.
+VOID InstrumentLazyBbl(BBL bbl) {
+    RTN rtn = RTN_FindByAddress(BBL_Address(bbl));
+    if (!RTN_Valid(rtn)) {
+        return;
+    }
+    FunctionStats* stats = LookupFunction(rtn);
+    if (stats == nullptr) {
+        return;
+    }
+
+    bool track = KnobTrackCallHierarchy.Value();
+    bool countHere = !bblGranularity && stats->firstSlot != INVALID_SLOT;
+    ADDRINT entry = RTN_Address(rtn);
+    IMG img = SEC_Img(RTN_Sec(rtn));
+
+    for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+        if (track && INS_Address(ins) == entry) {
+            InsertFunctionEntry(ins, *stats);
+        }
+        if (track && INS_IsRet(ins)) {
+            InsertFunctionReturn(ins);
+        }
+
+        if (!countHere) {
+            continue;
+        }
+
+        ADDRINT address = INS_Address(ins);
+        auto known = lazySlots.find(address);
+        UINT32 slot;
+        if (known != lazySlots.end()) {
+            slot = known->second;
+        } else {
+            slot = ArithSlot(ins, img, *stats);
+            lazySlots.emplace(address, slot);
+        }
+        if (slot != INVALID_SLOT) {
+            InsertArithCounter(ins, analysis.arithCounter, slot);
+        }
+    }
+}
+
+// Registrar (o encontrar) el sitio de una llamada indirecta. Con
+// threadsLock: ThreadFini recorre icallSites al fusionar
+IcallSite* RegisterIcallSite(INS ins, FunctionStats* caller) {
+    ADDRINT address = INS_Address(ins);
+    auto known = icallSiteIndex.find(address);
+    if (known != icallSiteIndex.end()) {
+        return &icallSites[known->second];
+    }
+
+    UINT32 slot = AllocateSlots(2 * ICALL_WAYS);
+    if (slot == INVALID_SLOT) {
+        return nullptr;
+    }
+
+    PIN_GetLock(&threadsLock, PIN_ThreadId() + 1);
+    icallSiteIndex[address] = icallSites.size();
+    icallSites.push_back({address, slot, caller, {}});
+    IcallSite* site = &icallSites.back();
+    PIN_ReleaseLock(&threadsLock);
+    return site;
+}
+
+// -icall: histograma de destinos de una llamada indirecta de una función de
+// interés. Mismo camino que los contadores aritméticos: base en el registro
+// de herramienta, slot fijado al instrumentar y condición inline
+VOID InstrumentIndirectCall(INS ins) {
+    // Rebanada sin instrumentar (-sample slice): los conteos se escalan
+    if (!samplingOn) {
+        return;
+    }
+
+    RTN rtn = RTN_FindByAddress(INS_Address(ins));
+    if (!RTN_Valid(rtn)) {
+        return;
+    }
+    FunctionStats* caller = LookupFunction(rtn);
+    if (caller == nullptr) {
+        return;
+    }
+    IcallSite* site = RegisterIcallSite(ins, caller);
+    if (site == nullptr) {
+        return;
+    }
+
+    INS_InsertIfCall(ins, IPOINT_BEFORE, analysis.icallHit,
+                    IARG_FAST_ANALYSIS_CALL,
+                    IARG_REG_VALUE, counterBaseReg,
+                    IARG_UINT32, site->slot,
+                    IARG_BRANCH_TARGET_ADDR,
+                    IARG_END);
+    INS_InsertThenCall(ins, IPOINT_BEFORE, (AFUNPTR)RecordIcallTarget,
+                      IARG_FAST_ANALYSIS_CALL,
+                      IARG_REG_VALUE, counterBaseReg,
+                      IARG_UINT32, site->slot,
+                      IARG_BRANCH_TARGET_ADDR,
+                      IARG_THREAD_ID,
+                      IARG_END);
+}
+
+// Instrumentación por trace: bloques (-bbl), rutinas (-lazy) y llamadas
+// indirectas (punteros a función, tablas virtuales)
+VOID InstrumentTrace(TRACE trace, VOID *v) {
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+        if (lazyInstrumentation) {
+            InstrumentLazyBbl(bbl);
+        }
+        if (bblGranularity) {
+            InstrumentBbl(bbl);
+        }
+
+        for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+            if (roiUntilReturn && INS_IsRet(ins)) {
+                InsertRoiFrameCheck(ins);
+            }
 
-KNOB<BOOL> KnobIncludeLibraries(KNOB_MODE_WRITEONCE, "pintool",
-    "l", "0", "Incluir bibliotecas dinámicas en la instrumentación");
+            // Detectar llamadas indirectas
+            if (INS_IsIndirectControlFlow(ins)) {
+                if (KnobVerbose.Value()) {
+                    std::cerr << "Llamada indirecta detectada @ 0x"
+                              << std::hex << INS_Address(ins) << std::dec
+                              << std::endl;
+                }
+                if (icallEnabled && INS_IsCall(ins)) {
+                    InstrumentIndirectCall(ins);
+                }
+            }
+        }
+    }
+}
 
 // ============================================================================
-// FUNCIONES AUXILIARES
+// THREADS
 // ============================================================================
 
-// Clasificar una instrucción aritmética
-ArithType ClassifyArithmeticInstruction(INS ins) {
-    OPCODE opcode = INS_Opcode(ins);
+// Crear el arreglo privado de contadores del thread. calloc de un bloque
+// grande se sirve con mmap, así que solo se materializan las páginas tocadas.
+// Con -live el arreglo es la porción del thread en el archivo mapeado
+// (también disperso); el análisis no cambia, solo la base del registro.
+VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v) {
+    ThreadData* td = new ThreadData();
+
+    PIN_GetLock(&threadsLock, tid + 1);
+    if (liveHeader != nullptr && liveHeader->numThreads < liveHeader->maxThreads) {
+        td->counters = reinterpret_cast<UINT64*>(
+            LiveThreadCounters(liveBase, liveHeader, liveHeader->numThreads));
+        td->liveCounters = true;
+        liveHeader->numThreads = liveHeader->numThreads + 1;
+    }
+    PIN_ReleaseLock(&threadsLock);
 
-    // Instrucciones enteras básicas
-    if (opcode == XED_ICLASS_ADD) return ARITH_ADD;
-    if (opcode == XED_ICLASS_SUB) return ARITH_SUB;
-    if (opcode == XED_ICLASS_MUL) return ARITH_MUL;
-    if (opcode == XED_ICLASS_DIV) return ARITH_DIV;
-    if (opcode == XED_ICLASS_INC) return ARITH_INC;
-    if (opcode == XED_ICLASS_DEC) return ARITH_DEC;
-    if (opcode == XED_ICLASS_NEG) return ARITH_NEG;
-    if (opcode == XED_ICLASS_IMUL) return ARITH_IMUL;
-    if (opcode == XED_ICLASS_IDIV) return ARITH_IDIV;
+    if (td->counters == nullptr) {
+        td->counters = static_cast<UINT64*>(calloc(KnobMaxSlots.Value(), sizeof(UINT64)));
+    }
+    if (td->counters == nullptr) {
+        std::cerr << "Error: no se pudo reservar contadores para el thread "
+                  << tid << std::endl;
+        PIN_ExitProcess(1);
+    }
+    td->counters[SAMPLE_COUNTDOWN_SLOT] = samplePeriod;
+    td->counters[SAMPLE_RNG_SLOT] = (tid + 1) * 0x9E3779B97F4A7C15ULL;
+    td->shadowStack.reserve(256);
+    td->cctNodes.reserve(1024);
+    td->cctNodes.push_back({CCT_ROOT, 0, 0, 0});
+
+    PIN_SetThreadData(tlsKey, td, tid);
+    PIN_SetContextReg(ctxt, counterBaseReg, reinterpret_cast<ADDRINT>(td->counters));
+
+    PIN_GetLock(&threadsLock, tid + 1);
+    allThreads.push_back(td);
+    PIN_ReleaseLock(&threadsLock);
+}
 
-    // SIMD Integer (SSE2/AVX2)
-    if (opcode == XED_ICLASS_PADDB || opcode == XED_ICLASS_PADDW ||
-        opcode == XED_ICLASS_PADDD || opcode == XED_ICLASS_PADDQ ||
-        opcode == XED_ICLASS_VPADDB || opcode == XED_ICLASS_VPADDW ||
-        opcode == XED_ICLASS_VPADDD || opcode == XED_ICLASS_VPADDQ)
-        return ARITH_SIMD_ADD;
+// -icall: pasar las vías y la tabla lateral del thread a cada sitio. Los
+// slots de las vías guardan direcciones, así que no se suman como conteos
+VOID MergeIcallTargets(ThreadData* td) {
+    for (IcallSite& site : icallSites) {
+        const UINT64* ways = td->counters + site.slot;
+        for (UINT32 w = 0; w < ICALL_WAYS; w++) {
+            if (ways[2 * w + 1] > 0) {
+                site.targets[ways[2 * w]] += ways[2 * w + 1];
+            }
+        }
+        auto overflow = td->icallOverflow.find(site.slot);
+        if (overflow != td->icallOverflow.end()) {
+            for (const auto& entry : overflow->second) {
+                site.targets[entry.first] += entry.second;
+            }
+        }
+    }
+    td->icallOverflow.clear();
+}
 
-    if (opcode == XED_ICLASS_PSUBB || opcode == XED_ICLASS_PSUBW ||
-        opcode == XED_ICLASS_PSUBD || opcode == XED_ICLASS_PSUBQ ||
-        opcode == XED_ICLASS_VPSUBB || opcode == XED_ICLASS_VPSUBW ||
-        opcode == XED_ICLASS_VPSUBD || opcode == XED_ICLASS_VPSUBQ)
-        return ARITH_SIMD_SUB;
+// Sumar los contadores de un thread al acumulado global (con threadsLock)
+VOID MergeThreadCounters(ThreadData* td) {
+    if (td->merged) {
+        return;
+    }
 
-    if (opcode == XED_ICLASS_PMULLW || opcode == XED_ICLASS_PMULLD ||
-        opcode == XED_ICLASS_VPMULLW || opcode == XED_ICLASS_VPMULLD ||
-        opcode == XED_ICLASS_PMULUDQ || opcode == XED_ICLASS_VPMULUDQ)
-        return ARITH_SIMD_MUL;
+    AttributeToCurrentContext(td);
+    MergeIcallTargets(td);
 
-    // SSE Floating Point
-    if (opcode == XED_ICLASS_ADDSS || opcode == XED_ICLASS_ADDSD ||
-        opcode == XED_ICLASS_ADDPS || opcode == XED_ICLASS_ADDPD)
-        return ARITH_SSE_ADD;
+    mergedCounters.resize(numSlots, 0);
+    for (UINT32 slot = 0; slot < numSlots; slot++) {
+        mergedCounters[slot] += td->counters[slot];
+    }
 
-    if (opcode == XED_ICLASS_SUBSS || opcode == XED_ICLASS_SUBSD ||
-        opcode == XED_ICLASS_SUBPS || opcode == XED_ICLASS_SUBPD)
-        return ARITH_SSE_SUB;
+    // Los arreglos de -live quedan en el archivo para statview
+    if (!td->liveCounters) {
+        free(td->counters);
+    }
+    td->counters = nullptr;
+    td->merged = true;
+}
 
-    if (opcode == XED_ICLASS_MULSS || opcode == XED_ICLASS_MULSD ||
-        opcode == XED_ICLASS_MULPS || opcode == XED_ICLASS_MULPD)
-        return ARITH_SSE_MUL;
+// Suma en vivo de TOTAL_SLOT de todos los threads (modo slice)
+UINT64 SumArithTotals() {
+    PIN_GetLock(&threadsLock, PIN_ThreadId() + 1);
+    UINT64 total = mergedCounters.empty() ? 0 : mergedCounters[TOTAL_SLOT];
+    for (ThreadData* td : allThreads) {
+        if (!td->merged) {
+            total += td->counters[TOTAL_SLOT];
+        }
+    }
+    PIN_ReleaseLock(&threadsLock);
+    return total;
+}
 
-    if (opcode == XED_ICLASS_DIVSS || opcode == XED_ICLASS_DIVSD ||
-        opcode == XED_ICLASS_DIVPS || opcode == XED_ICLASS_DIVPD)
-        return ARITH_SSE_DIV;
+// Fusionar al terminar el thread para liberar su arreglo cuanto antes
+VOID ThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v) {
+    ThreadData* td = static_cast<ThreadData*>(PIN_GetThreadData(tlsKey, tid));
+    if (td == nullptr) {
+        return;
+    }
 
-    // AVX Floating Point
-    if (opcode == XED_ICLASS_VADDSS || opcode == XED_ICLASS_VADDSD ||
-        opcode == XED_ICLASS_VADDPS || opcode == XED_ICLASS_VADDPD)
-        return ARITH_AVX_ADD;
+    PIN_GetLock(&threadsLock, tid + 1);
+    MergeThreadCounters(td);
+    PIN_ReleaseLock(&threadsLock);
+}
 
-    if (opcode == XED_ICLASS_VSUBSS || opcode == XED_ICLASS_VSUBSD ||
-        opcode == XED_ICLASS_VSUBPS || opcode == XED_ICLASS_VSUBPD)
-        return ARITH_AVX_SUB;
+// Fusionar los threads que sigan vivos y repartir los slots en las funciones
+VOID MergeAllThreads() {
+    PIN_GetLock(&threadsLock, PIN_ThreadId() + 1);
+    for (ThreadData* td : allThreads) {
+        MergeThreadCounters(td);
+    }
+    mergedCounters.resize(numSlots, 0);
+    PIN_ReleaseLock(&threadsLock);
 
-    if (opcode == XED_ICLASS_VMULSS || opcode == XED_ICLASS_VMULSD ||
-        opcode == XED_ICLASS_VMULPS || opcode == XED_ICLASS_VMULPD)
-        return ARITH_AVX_MUL;
+    for (auto& entry : functionStatsMap) {
+        FunctionStats& stats = entry.second;
+        if (stats.firstSlot == INVALID_SLOT) {
+            continue;
+        }
+        for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+            stats.arithCounts[t] = mergedCounters[stats.firstSlot + t];
+        }
+    }
+}
 
-    if (opcode == XED_ICLASS_VDIVSS || opcode == XED_ICLASS_VDIVSD ||
-        opcode == XED_ICLASS_VDIVPS || opcode == XED_ICLASS_VDIVPD)
-        return ARITH_AVX_DIV;
+// ============================================================================
+// MUESTREO
+// ============================================================================
 
-    // FPU x87
-    if (opcode == XED_ICLASS_FADD || opcode == XED_ICLASS_FADDP ||
-        opcode == XED_ICLASS_FIADD)
-        return ARITH_FPU_ADD;
+double NowSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
 
-    if (opcode == XED_ICLASS_FSUB || opcode == XED_ICLASS_FSUBP ||
-        opcode == XED_ICLASS_FISUB || opcode == XED_ICLASS_FSUBR ||
-        opcode == XED_ICLASS_FSUBRP)
-        return ARITH_FPU_SUB;
+// Dormir en pasos cortos para poder terminar rápido en PrepareForFini
+VOID SleepUnlessStopping(UINT32 ms) {
+    const UINT32 step = 5;
+    for (UINT32 slept = 0; slept < ms && !sliceControllerStop; slept += step) {
+        PIN_Sleep(std::min(step, ms - slept));
+    }
+}
 
-    if (opcode == XED_ICLASS_FMUL || opcode == XED_ICLASS_FMULP ||
-        opcode == XED_ICLASS_FIMUL)
-        return ARITH_FPU_MUL;
+// Thread interno del modo slice: alterna rebanadas instrumentadas de
+// sliceOnMs y nativas de sliceOffMs, recompilando el code cache en cada
+// cambio. Mide lo contado en cada rebanada instrumentada.
+VOID SliceController(VOID *arg) {
+    while (!sliceControllerStop) {
+        UINT64 before = SumArithTotals();
+        double start = NowSeconds();
+        SleepUnlessStopping(sliceOnMs);
+        slices.push_back({SumArithTotals() - before, NowSeconds() - start});
+
+        if (sliceControllerStop) {
+            break;
+        }
 
-    if (opcode == XED_ICLASS_FDIV || opcode == XED_ICLASS_FDIVP ||
-        opcode == XED_ICLASS_FIDIV || opcode == XED_ICLASS_FDIVR ||
-        opcode == XED_ICLASS_FDIVRP)
-        return ARITH_FPU_DIV;
+        samplingOn = 0;
+        PIN_RemoveInstrumentation();
+        start = NowSeconds();
+        SleepUnlessStopping(sliceOffMs);
+        nativeSeconds += NowSeconds() - start;
 
-    return ARITH_UNKNOWN;
+        samplingOn = 1;
+        PIN_RemoveInstrumentation();
+    }
 }
 
-// Determinar si una instrucción es aritmética
-bool IsArithmeticInstruction(INS ins) {
-    return ClassifyArithmeticInstruction(ins) != ARITH_UNKNOWN;
+VOID PrepareForFini(VOID *v) {
+    sliceControllerStop = true;
+    PIN_WaitForThreadTermination(sliceControllerUid, PIN_INFINITE_TIMEOUT, nullptr);
 }
 
-// Obtener el nombre demangled de una función
-string GetDemangledName(const string& mangledName) {
-    string demangled = mangledName;
-
-    #if defined(TARGET_LINUX) || defined(TARGET_MAC)
-    // Intentar demangle para C++
-    PIN_UndecorateSymbolName(mangledName, UNDECORATION_COMPLETE);
-    #endif
-
-    return demangled;
-}
-
-// Verificar si una función está en el conjunto de interés
-bool IsFunctionOfInterest(const string& funcName) {
-    if (functionsOfInterest.empty()) {
-        return true; // Sin filtro, todas las funciones son de interés
+// Configurar el muestreo según los knobs. En modo slice el ciclo de trabajo
+// d sale de pedir slowdown = d * K + (1 - d) con K el slowdown del modo exacto
+bool ConfigureSampling() {
+    const string& mode = KnobSampleMode.Value();
+    if (mode.empty()) {
+        return true;
     }
 
-    // Búsqueda exacta
-    if (functionsOfInterest.find(funcName) != functionsOfInterest.end()) {
+    if (mode == "bbl") {
+        sampleMode = SAMPLE_BBL;
+        samplePeriod = std::max<UINT64>(KnobSamplePeriod.Value(), 1);
+        sampleMeanGap = static_cast<double>(samplePeriod);
+        std::cerr << "Muestreo bbl: 1 de cada " << samplePeriod
+                  << " ejecuciones de BBL" << std::endl;
         return true;
     }
 
-    // Búsqueda por substring (para funciones con namespaces)
-    for (const auto& target : functionsOfInterest) {
-        if (funcName.find(target) != string::npos) {
+    if (mode == "slice") {
+        double k = std::max<UINT32>(KnobExactSlowdown.Value(), 1);
+        double target = std::max<UINT32>(KnobMaxSlowdown.Value(), 1);
+        double duty = (k > 1) ? (target - 1) / (k - 1) : 1.0;
+        duty = std::min(1.0, std::max(0.01, duty));
+
+        if (duty >= 1.0) {
+            std::cerr << "Muestreo slice: el slowdown objetivo no requiere muestreo" << std::endl;
             return true;
         }
+
+        sampleMode = SAMPLE_SLICE;
+        sliceOnMs = std::max<UINT32>(KnobSliceMs.Value(), 1);
+        sliceOffMs = static_cast<UINT32>(sliceOnMs * (1 - duty) / (duty * k));
+        std::cerr << "Muestreo slice: " << sliceOnMs << " ms instrumentados, "
+                  << sliceOffMs << " ms nativos (ciclo " << duty * 100 << "%)" << std::endl;
+        return true;
     }
 
+    std::cerr << "Error: modo de muestreo desconocido: " << mode << std::endl;
     return false;
 }
 
-// ============================================================================
-// FUNCIONES DE ANÁLISIS (CALLBACKS)
-// ============================================================================
+// Escalar los conteos muestreados y calcular las cotas (IC 95%).
+// bbl: cada muestra vale sampleMeanGap ejecuciones; la varianza por función
+//      (aproximación de Poisson) se acumula en ExpandBblCounts.
+// slice: tasa por segundo instrumentado en cada rebanada, extrapolada a las
+//        rebanadas nativas (K veces más rápidas); el IC sale de la
+//        dispersión entre rebanadas.
+VOID EstimateSampledCounts(UINT64 observedTotal) {
+    if (sampleMode == SAMPLE_BBL) {
+        double globalVariance = 0;
+        for (auto& entry : functionStatsMap) {
+            FunctionStats& stats = entry.second;
+            stats.arithBound = CONFIDENCE_Z * std::sqrt(stats.arithVariance);
+            globalVariance += stats.arithVariance;
+        }
+        sampleGlobalBound = CONFIDENCE_Z * std::sqrt(globalVariance);
+        return;
+    }
 
-// Callback para contar instrucciones aritméticas
-VOID CountArithmeticInstruction(ADDRINT funcAddr, ArithType type) {
-    FunctionStats& stats = functionStatsMap[funcAddr];
-    stats.arithCounts[type]++;
-    stats.totalArithInstructions++;
-}
+    if (sampleMode != SAMPLE_SLICE || observedTotal == 0 || slices.empty()) {
+        return;
+    }
 
-// Callback para entrada de función
-VOID FunctionEntry(ADDRINT funcAddr, ADDRINT callSite) {
-    if (KnobTrackCallHierarchy.Value()) {
-        CallContext ctx;
-        ctx.functionName = functionNames[funcAddr];
-        ctx.callSite = callSite;
-        ctx.depth = callStack.size();
-        callStack.push_back(ctx);
+    double meanRate = 0;
+    for (const SliceSample& slice : slices) {
+        meanRate += slice.arith / std::max(slice.seconds, 1e-9);
+    }
+    meanRate /= slices.size();
 
-        if (KnobVerbose.Value()) {
-            std::cerr << string(ctx.depth * 2, ' ')
-                      << "-> " << ctx.functionName
-                      << " @ 0x" << std::hex << funcAddr << std::dec
-                      << std::endl;
-        }
+    double variance = 0;
+    for (const SliceSample& slice : slices) {
+        double rate = slice.arith / std::max(slice.seconds, 1e-9);
+        variance += (rate - meanRate) * (rate - meanRate);
     }
-}
+    variance = (slices.size() > 1) ? variance / (slices.size() - 1) : 0;
+
+    double k = std::max<UINT32>(KnobExactSlowdown.Value(), 1);
+    double estimated = observedTotal + nativeSeconds * k * meanRate;
+    double bound = CONFIDENCE_Z * nativeSeconds * k * std::sqrt(variance / slices.size());
 
-// Callback para salida de función
-VOID FunctionExit(ADDRINT funcAddr) {
-    if (KnobTrackCallHierarchy.Value() && !callStack.empty()) {
-        callStack.pop_back();
+    sampleScale = estimated / observedTotal;
+    sampleGlobalBound = bound;
+
+    for (auto& entry : functionStatsMap) {
+        FunctionStats& stats = entry.second;
+        for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+            stats.arithCounts[t] = static_cast<UINT64>(stats.arithCounts[t] * sampleScale + 0.5);
+        }
+        stats.totalArithInstructions = static_cast<UINT64>(stats.totalArithInstructions * sampleScale + 0.5);
+        stats.arithBound = bound * stats.totalArithInstructions / estimated;
     }
 }
 
 // ============================================================================
-// INSTRUMENTACIÓN
+// SALIDA DE RESULTADOS
 // ============================================================================
 
-// Instrumentar una rutina (función)
-VOID InstrumentRoutine(RTN rtn, VOID *v) {
-    RTN_Open(rtn);
-
-    string rtnName = RTN_Name(rtn);
-    ADDRINT rtnAddr = RTN_Address(rtn);
-    IMG img = SEC_Img(RTN_Sec(rtn));
-    string imgName = IMG_Name(img);
+// Fusionar los CCT de todos los threads (por camino) en un solo árbol. Los
+// nodos se crean en orden, así que el padre siempre precede al hijo.
+VOID MergeCallingContexts(vector<CctNode>& merged) {
+    unordered_map<UINT64, UINT32> children;
+    merged.clear();
+    merged.push_back({CCT_ROOT, 0, 0, 0});
+
+    for (ThreadData* td : allThreads) {
+        vector<UINT32> toMerged(td->cctNodes.size(), CCT_ROOT);
+        for (UINT32 i = 1; i < td->cctNodes.size(); i++) {
+            const CctNode& node = td->cctNodes[i];
+            UINT32 parent = toMerged[node.parent];
+            UINT64 key = (static_cast<UINT64>(parent) << 32) | node.functionId;
+
+            auto it = children.find(key);
+            if (it == children.end()) {
+                it = children.emplace(key, merged.size()).first;
+                merged.push_back({parent, node.functionId, node.depth, 0});
+            }
+            toMerged[i] = it->second;
+            merged[it->second].arithCount += node.arithCount;
+        }
+        merged[CCT_ROOT].arithCount += td->cctNodes[CCT_ROOT].arithCount;
+    }
+}
 
-    // Filtrar bibliotecas si es necesario
-    if (!KnobIncludeLibraries.Value() && IMG_Type(img) == IMG_TYPE_SHAREDLIB) {
-        RTN_Close(rtn);
-        return;
+// Camino de llamadas de un nodo: "EvalMult -> KeySwitch -> NTT"
+string ContextPath(const vector<CctNode>& nodes, UINT32 node) {
+    vector<UINT32> path;
+    for (; node != CCT_ROOT; node = nodes[node].parent) {
+        path.push_back(nodes[node].functionId);
     }
 
-    // Filtrar por funciones de interés
-    if (!IsFunctionOfInterest(rtnName)) {
-        RTN_Close(rtn);
-        return;
+    string result;
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        if (!result.empty()) {
+            result += " -> ";
+        }
+        result += functionsById[*it]->name;
     }
+    return result;
+}
 
-    // Inicializar estadísticas de la función
-    if (functionStatsMap.find(rtnAddr) == functionStatsMap.end()) {
-        FunctionStats stats;
-        stats.name = rtnName;
-        stats.address = rtnAddr;
-        functionStatsMap[rtnAddr] = stats;
-        functionNames[rtnAddr] = rtnName;
+// Reporte de los contextos de llamada con más aritmética exclusiva
+VOID GenerateContextReport() {
+    vector<CctNode> nodes;
+    MergeCallingContexts(nodes);
 
-        if (KnobVerbose.Value()) {
-            std::cerr << "Instrumentando función: " << rtnName
-                      << " @ 0x" << std::hex << rtnAddr << std::dec
-                      << " en " << imgName << std::endl;
+    vector<UINT32> hottest;
+    for (UINT32 i = 1; i < nodes.size(); i++) {
+        if (nodes[i].arithCount > 0) {
+            hottest.push_back(i);
         }
     }
 
-    // Instrumentar entrada y salida de función
-    if (KnobTrackCallHierarchy.Value()) {
-        RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)FunctionEntry,
-                      IARG_ADDRINT, rtnAddr,
-                      IARG_RETURN_IP,
-                      IARG_END);
+    UINT32 top = std::min<size_t>(KnobTopContexts.Value(), hottest.size());
+    std::partial_sort(hottest.begin(), hottest.begin() + top, hottest.end(),
+                      [&nodes](UINT32 a, UINT32 b) {
+                          return nodes[a].arithCount > nodes[b].arithCount;
+                      });
 
-        RTN_InsertCall(rtn, IPOINT_AFTER, (AFUNPTR)FunctionExit,
-                      IARG_ADDRINT, rtnAddr,
-                      IARG_END);
+    outFile << std::endl;
+    outFile << "========================================" << std::endl;
+    outFile << "CONTEXTOS DE LLAMADA MÁS CALIENTES" << std::endl;
+    outFile << "========================================" << std::endl;
+    outFile << "Contextos distintos: " << nodes.size() - 1 << std::endl;
+    outFile << std::setw(15) << "Conteo" << "  Contexto (exclusivo)" << std::endl;
+    outFile << string(50, '-') << std::endl;
+
+    for (UINT32 i = 0; i < top; i++) {
+        UINT64 count = static_cast<UINT64>(nodes[hottest[i]].arithCount * sampleScale + 0.5);
+        outFile << std::setw(15) << count << "  "
+                << ContextPath(nodes, hottest[i]) << std::endl;
     }
+}
 
-    // Instrumentar cada instrucción en la rutina
-    for (INS ins = RTN_InsHead(rtn); INS_Valid(ins); ins = INS_Next(ins)) {
-        if (IsArithmeticInstruction(ins)) {
-            ArithType type = ClassifyArithmeticInstruction(ins);
+// Nombre de la rutina destino de una llamada indirecta
+string IcallTargetName(ADDRINT target) {
+    PIN_LockClient();
+    string name = RTN_FindNameByAddress(target);
+    PIN_UnlockClient();
+    return name.empty() ? "?" : name;
+}
 
-            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)CountArithmeticInstruction,
-                          IARG_ADDRINT, rtnAddr,
-                          IARG_UINT32, type,
-                          IARG_END);
-        }
+// Destinos de un sitio ordenados por conteo (solo punteros a sus entradas)
+vector<const pair<const ADDRINT, UINT64>*> SortedIcallTargets(const IcallSite& site) {
+    vector<const pair<const ADDRINT, UINT64>*> sorted;
+    for (const auto& entry : site.targets) {
+        sorted.push_back(&entry);
     }
-
-    RTN_Close(rtn);
+    std::sort(sorted.begin(), sorted.end(), [](const pair<const ADDRINT, UINT64>* a,
+                                               const pair<const ADDRINT, UINT64>* b) {
+        return a->second > b->second;
+    });
+    return sorted;
 }
 
-// Instrumentar imágenes cargadas (para manejar bibliotecas dinámicas)
-VOID ImageLoad(IMG img, VOID *v) {
-    if (KnobVerbose.Value()) {
-        std::cerr << "Cargando imagen: " << IMG_Name(img)
-                  << " @ 0x" << std::hex << IMG_LowAddress(img) << std::dec
-                  << std::endl;
+// Reporte de llamadas indirectas (-icall), agrupado por función llamadora
+// y ordenado por cantidad de llamadas
+VOID GenerateIcallReport() {
+    vector<UINT64> siteTotals(icallSites.size(), 0);
+    unordered_map<UINT32, UINT64> callerTotals;
+    UINT64 total = 0;
+    for (UINT32 i = 0; i < icallSites.size(); i++) {
+        for (const auto& entry : icallSites[i].targets) {
+            siteTotals[i] += entry.second;
+        }
+        callerTotals[icallSites[i].caller->id] += siteTotals[i];
+        total += siteTotals[i];
     }
 
-    // Instrumentar todas las rutinas en la imagen
-    for (SEC sec = IMG_SecHead(img); SEC_Valid(sec); sec = SEC_Next(sec)) {
-        for (RTN rtn = SEC_RtnHead(sec); RTN_Valid(rtn); rtn = RTN_Next(rtn)) {
-            InstrumentRoutine(rtn, v);
+    vector<UINT32> order;
+    for (UINT32 i = 0; i < icallSites.size(); i++) {
+        if (siteTotals[i] > 0) {
+            order.push_back(i);
         }
     }
-}
+    std::sort(order.begin(), order.end(), [&](UINT32 a, UINT32 b) {
+        UINT64 callerA = callerTotals[icallSites[a].caller->id];
+        UINT64 callerB = callerTotals[icallSites[b].caller->id];
+        if (callerA != callerB) {
+            return callerA > callerB;
+        }
+        if (icallSites[a].caller != icallSites[b].caller) {
+            return icallSites[a].caller->id < icallSites[b].caller->id;
+        }
+        return siteTotals[a] > siteTotals[b];
+    });
 
-// Manejar llamadas indirectas (punteros a función, tablas virtuales)
-VOID InstrumentTrace(TRACE trace, VOID *v) {
-    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
-        for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
-            // Detectar llamadas indirectas
-            if (INS_IsIndirectControlFlow(ins)) {
-                if (KnobVerbose.Value()) {
-                    std::cerr << "Llamada indirecta detectada @ 0x"
-                              << std::hex << INS_Address(ins) << std::dec
-                              << std::endl;
-                }
+    outFile << std::endl;
+    outFile << "========================================" << std::endl;
+    outFile << "LLAMADAS INDIRECTAS POR FUNCIÓN" << std::endl;
+    outFile << "========================================" << std::endl;
+    outFile << "Sitios ejecutados: " << order.size() << " de " << icallSites.size()
+            << ", llamadas: " << static_cast<UINT64>(total * sampleScale + 0.5) << std::endl;
+
+    const FunctionStats* caller = nullptr;
+    for (UINT32 index : order) {
+        const IcallSite& site = icallSites[index];
+        if (site.caller != caller) {
+            caller = site.caller;
+            outFile << "----------------------------------------" << std::endl;
+            outFile << "Función: " << caller->name << " ("
+                    << static_cast<UINT64>(callerTotals[caller->id] * sampleScale + 0.5)
+                    << " llamadas indirectas)" << std::endl;
+        }
+
+        outFile << "  Sitio 0x" << std::hex << site.address << std::dec << ": "
+                << static_cast<UINT64>(siteTotals[index] * sampleScale + 0.5) << " llamadas, "
+                << site.targets.size() << (site.targets.size() == 1 ? " destino" : " destinos")
+                << std::endl;
+
+        auto sorted = SortedIcallTargets(site);
+        UINT64 rest = 0;
+        for (UINT32 i = 0; i < sorted.size(); i++) {
+            if (i >= ICALL_REPORT_TARGETS) {
+                rest += sorted[i]->second;
+                continue;
             }
+            double percentage = (100.0 * sorted[i]->second) / siteTotals[index];
+            outFile << std::setw(17) << static_cast<UINT64>(sorted[i]->second * sampleScale + 0.5)
+                    << std::setw(9) << std::fixed << std::setprecision(2) << percentage << "%  "
+                    << IcallTargetName(sorted[i]->first)
+                    << " @ 0x" << std::hex << sorted[i]->first << std::dec << std::endl;
+        }
+        if (rest > 0) {
+            outFile << std::setw(17) << static_cast<UINT64>(rest * sampleScale + 0.5)
+                    << "  (otros " << sorted.size() - ICALL_REPORT_TARGETS << " destinos)" << std::endl;
         }
     }
 }
 
-// ============================================================================
-// SALIDA DE RESULTADOS
-// ============================================================================
-
 // Comparador para ordenar funciones por total de instrucciones aritméticas
-bool CompareFunctionStats(const pair<ADDRINT, FunctionStats>& a,
-                         const pair<ADDRINT, FunctionStats>& b) {
-    return a.second.totalArithInstructions > b.second.totalArithInstructions;
+bool CompareFunctionStats(const FunctionStats* a, const FunctionStats* b) {
+    return a->totalArithInstructions > b->totalArithInstructions;
 }
 
 // Generar reporte
@@ -399,20 +1802,21 @@ VOID GenerateReport() {
     outFile << "========================================" << std::endl;
     outFile << std::endl;
 
-    // Convertir a vector para ordenar
-    vector<pair<ADDRINT, FunctionStats>> sortedStats(
-        functionStatsMap.begin(), functionStatsMap.end());
+    // Ordenar punteros, sin copiar las estadísticas
+    vector<const FunctionStats*> sortedStats;
+    sortedStats.reserve(functionsById.size());
+    for (const FunctionStats* stats : functionsById) {
+        if (stats->totalArithInstructions > 0) {
+            sortedStats.push_back(stats);
+        }
+    }
 
     std::sort(sortedStats.begin(), sortedStats.end(), CompareFunctionStats);
 
     UINT64 grandTotal = 0;
 
-    for (const auto& entry : sortedStats) {
-        const FunctionStats& stats = entry.second;
-
-        if (stats.totalArithInstructions == 0) {
-            continue;
-        }
+    for (const FunctionStats* entry : sortedStats) {
+        const FunctionStats& stats = *entry;
 
         grandTotal += stats.totalArithInstructions;
 
@@ -420,6 +1824,10 @@ VOID GenerateReport() {
         outFile << "Función: " << stats.name << std::endl;
         outFile << "Dirección: 0x" << std::hex << stats.address << std::dec << std::endl;
         outFile << "Total instrucciones aritméticas: " << stats.totalArithInstructions << std::endl;
+        if (sampleMode != SAMPLE_NONE) {
+            outFile << "Estimación por muestreo: ± " << static_cast<UINT64>(stats.arithBound)
+                    << " (IC 95%)" << std::endl;
+        }
 
         if (stats.isInlined) {
             outFile << "NOTA: Esta función puede estar inline" << std::endl;
@@ -431,11 +1839,11 @@ VOID GenerateReport() {
                 << std::setw(15) << "Porcentaje" << std::endl;
         outFile << string(50, '-') << std::endl;
 
-        for (const auto& countEntry : stats.arithCounts) {
-            if (countEntry.second > 0) {
-                double percentage = (100.0 * countEntry.second) / stats.totalArithInstructions;
-                outFile << std::setw(20) << ArithTypeNames[countEntry.first]
-                        << std::setw(15) << countEntry.second
+        for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+            if (stats.arithCounts[t] > 0) {
+                double percentage = (100.0 * stats.arithCounts[t]) / stats.totalArithInstructions;
+                outFile << std::setw(20) << ArithTypeNames[t]
+                        << std::setw(15) << stats.arithCounts[t]
                         << std::setw(14) << std::fixed << std::setprecision(2)
                         << percentage << "%" << std::endl;
             }
@@ -447,15 +1855,28 @@ VOID GenerateReport() {
     outFile << "========================================" << std::endl;
     outFile << "RESUMEN GLOBAL" << std::endl;
     outFile << "========================================" << std::endl;
-    outFile << "Total funciones instrumentadas: " << sortedStats.size() << std::endl;
+    outFile << "Total funciones instrumentadas: " << functionStatsMap.size() << std::endl;
     outFile << "Total instrucciones aritméticas: " << grandTotal << std::endl;
+    if (KnobStrict.Value()) {
+        outFile << "Sitios filtrados (punteros): " << filteredPointerSites << std::endl;
+        outFile << "Sitios filtrados (contadores de loop): " << filteredLoopCounterSites << std::endl;
+    }
+    if (sampleMode == SAMPLE_BBL) {
+        outFile << "Muestreo: 1 de cada " << samplePeriod << " ejecuciones de BBL, "
+                << "cota global ± " << static_cast<UINT64>(sampleGlobalBound) << " (IC 95%)" << std::endl;
+    } else if (sampleMode == SAMPLE_SLICE) {
+        outFile << "Muestreo: " << slices.size() << " rebanadas instrumentadas, "
+                << std::fixed << std::setprecision(2) << nativeSeconds << " s nativos, "
+                << "escala x" << sampleScale << ", "
+                << "cota global ± " << static_cast<UINT64>(sampleGlobalBound) << " (IC 95%)" << std::endl;
+    }
     outFile << std::endl;
 
     // Resumen por categoría
-    map<ArithType, UINT64> globalCounts;
+    UINT64 globalCounts[ARITH_NUM_TYPES] = {0};
     for (const auto& entry : functionStatsMap) {
-        for (const auto& countEntry : entry.second.arithCounts) {
-            globalCounts[countEntry.first] += countEntry.second;
+        for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+            globalCounts[t] += entry.second.arithCounts[t];
         }
     }
 
@@ -464,21 +1885,285 @@ VOID GenerateReport() {
             << std::setw(15) << "Porcentaje" << std::endl;
     outFile << string(50, '-') << std::endl;
 
-    for (const auto& countEntry : globalCounts) {
-        if (countEntry.second > 0) {
-            double percentage = (100.0 * countEntry.second) / grandTotal;
-            outFile << std::setw(20) << ArithTypeNames[countEntry.first]
-                    << std::setw(15) << countEntry.second
+    for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+        if (globalCounts[t] > 0) {
+            double percentage = (100.0 * globalCounts[t]) / grandTotal;
+            outFile << std::setw(20) << ArithTypeNames[t]
+                    << std::setw(15) << globalCounts[t]
                     << std::setw(14) << std::fixed << std::setprecision(2)
                     << percentage << "%" << std::endl;
         }
     }
 }
 
+// Perfil estructurado (-format bin|json|csv): las tablas se emiten
+// directamente desde functionsById, ipSites, icallSites y el CCT fusionado,
+// en orden de id y sin ordenar ni copiar (ver profile_format.h)
+bool WriteStructuredProfile(ProfileSink& sink) {
+    ProfileHeader summary = {};
+    summary.numTypes = ARITH_NUM_TYPES;
+    summary.sampling = sampleMode == SAMPLE_BBL ? PROFILE_SAMPLE_BBL :
+                       sampleMode == SAMPLE_SLICE ? PROFILE_SAMPLE_SLICE : PROFILE_EXACT;
+    summary.sampleScale = sampleScale;
+    summary.globalBound = sampleGlobalBound;
+    summary.filteredPointerSites = filteredPointerSites;
+    summary.filteredLoopCounterSites = filteredLoopCounterSites;
+
+    UINT64 globalCounts[ARITH_NUM_TYPES] = {0};
+    for (const FunctionStats* stats : functionsById) {
+        summary.total += stats->totalArithInstructions;
+        for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+            globalCounts[t] += stats->arithCounts[t];
+        }
+    }
+    sink.Begin(summary);
+
+    sink.BeginTable(PROFILE_TYPES);
+    for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+        sink.Type(t, ArithTypeNames[t], globalCounts[t]);
+    }
+    sink.EndTable();
+
+    // Todas las funciones registradas, así el id es el índice de la fila
+    sink.BeginTable(PROFILE_FUNCTIONS);
+    for (const FunctionStats* stats : functionsById) {
+        ProfileFunctionRecord r = {};
+        r.address = stats->address;
+        r.total = stats->totalArithInstructions;
+        r.bound = stats->arithBound;
+        r.id = stats->id;
+        sink.Function(r, stats->name);
+    }
+    sink.EndTable();
+
+    sink.BeginTable(PROFILE_FUNCTION_TYPES);
+    for (const FunctionStats* stats : functionsById) {
+        for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+            if (stats->arithCounts[t] > 0) {
+                sink.FunctionType({stats->id, t, stats->arithCounts[t]});
+            }
+        }
+    }
+    sink.EndTable();
+
+    // Conteos por IP escalados en -sample slice, como WriteIpProfileFile
+    if (ipProfileEnabled) {
+        sink.BeginTable(PROFILE_IMAGES);
+        for (UINT32 i = 0; i < ipProfileImages.size(); i++) {
+            sink.Image(i, ipProfileImages[i]);
+        }
+        sink.EndTable();
+
+        sink.BeginTable(PROFILE_IPS);
+        for (const IpSite& site : ipSites) {
+            UINT64 count = static_cast<UINT64>(site.count * sampleScale + 0.5);
+            if (count > 0) {
+                sink.Ip({site.offset, count, site.image, static_cast<UINT32>(site.type),
+                         site.function->id, 0});
+            }
+        }
+        sink.EndTable();
+    }
+
+    // Contextos sin la raíz: padre CCT_ROOT es una llamada de primer nivel
+    if (KnobTrackCallHierarchy.Value()) {
+        vector<CctNode> nodes;
+        MergeCallingContexts(nodes);
+        sink.BeginTable(PROFILE_CONTEXTS);
+        for (UINT32 i = 1; i < nodes.size(); i++) {
+            UINT64 count = static_cast<UINT64>(nodes[i].arithCount * sampleScale + 0.5);
+            sink.Context({i, nodes[i].parent, nodes[i].functionId, nodes[i].depth, count});
+        }
+        sink.EndTable();
+    }
+
+    // Un registro por (sitio, destino); caller indexa la tabla functions
+    if (icallEnabled) {
+        sink.BeginTable(PROFILE_ICALLS);
+        for (const IcallSite& site : icallSites) {
+            for (const auto& entry : site.targets) {
+                ProfileIcallRecord r = {};
+                r.site = site.address;
+                r.target = entry.first;
+                r.count = static_cast<UINT64>(entry.second * sampleScale + 0.5);
+                r.caller = site.caller->id;
+                sink.Icall(r, IcallTargetName(entry.first));
+            }
+        }
+        sink.EndTable();
+    }
+
+    return sink.End();
+}
+
+// Modo -bbl: expandir ejecuciones de cada bloque por su histograma
+// (en -sample bbl las ejecuciones se estiman como muestras * sampleMeanGap)
+VOID ExpandBblCounts() {
+    bool sampled = sampleMode == SAMPLE_BBL;
+    for (const BblStats& bblStats : bblStatsList) {
+        UINT64 samples = mergedCounters[bblStats.slot];
+        if (samples == 0) {
+            continue;
+        }
+
+        double executions = sampled ? samples * sampleMeanGap : samples;
+        for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+            bblStats.function->arithCounts[t] +=
+                static_cast<UINT64>(executions * bblStats.counts[t] + 0.5);
+        }
+        if (sampled) {
+            double weight = sampleMeanGap * bblStats.arithTotal;
+            bblStats.function->arithVariance += samples * weight * weight;
+        }
+    }
+}
+
+// -ip_profile: conteo de cada IP (su slot, o las ejecuciones de sus
+// bloques en -bbl) y, en modo por instrucción, conteos por tipo de la función
+VOID ExpandIpCounts() {
+    if (!ipProfileEnabled) {
+        return;
+    }
+
+    double executionsPerSample = sampleMode == SAMPLE_BBL ? sampleMeanGap : 1.0;
+    for (const BblStats& bblStats : bblStatsList) {
+        UINT64 executions = static_cast<UINT64>(mergedCounters[bblStats.slot] * executionsPerSample + 0.5);
+        for (UINT32 index : bblStats.ipSites) {
+            ipSites[index].count += executions;
+        }
+    }
+
+    for (IpSite& site : ipSites) {
+        if (site.slot != INVALID_SLOT) {
+            UINT64 count = mergedCounters[site.slot];
+            site.count += count;
+            site.function->arithCounts[site.type] += count;
+        }
+    }
+}
+
+// Escribir el perfil por IP (escalado en -sample slice, como el reporte)
+VOID WriteIpProfileFile() {
+    IpProfile profile;
+    profile.images = ipProfileImages;
+    profile.records.reserve(ipSites.size());
+    for (const IpSite& site : ipSites) {
+        UINT64 count = static_cast<UINT64>(site.count * sampleScale + 0.5);
+        if (count == 0) {
+            continue;
+        }
+        profile.records.push_back({site.offset, count, site.image,
+                                   static_cast<UINT16>(site.type), site.destinations});
+    }
+
+    if (!WriteIpProfile(KnobIpProfile.Value(), profile)) {
+        std::cerr << "ERROR: No se pudo escribir " << KnobIpProfile.Value() << std::endl;
+        return;
+    }
+    std::cerr << "Perfil por IP: " << profile.records.size() << " instrucciones en "
+              << KnobIpProfile.Value() << std::endl;
+}
+
+// Acumular los totales por función a partir de los slots por tipo
+VOID ComputeTotals() {
+    for (auto& entry : functionStatsMap) {
+        FunctionStats& stats = entry.second;
+        stats.totalArithInstructions = 0;
+        for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+            stats.totalArithInstructions += stats.arithCounts[t];
+        }
+    }
+}
+
+// Crear el archivo -live (disperso) y su .meta. Los tipos se describen en
+// el .meta para que statview no dependa de arith_classify.h
+bool OpenLiveStats(const string& path) {
+    UINT32 maxThreads = KnobLiveThreads.Value();
+    UINT64 size = LiveStatsFileSize(maxThreads, KnobMaxSlots.Value());
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, size) != 0) {
+        std::cerr << "Error: no se pudo crear " << path << std::endl;
+        return false;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "Error: no se pudo mapear " << path << std::endl;
+        return false;
+    }
+
+    liveMetaFd = open((path + ".meta").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (liveMetaFd < 0) {
+        std::cerr << "Error: no se pudo crear " << path << ".meta" << std::endl;
+        return false;
+    }
+    for (UINT32 t = 0; t < ARITH_NUM_TYPES; t++) {
+        LiveMeta("T " + decstr(t) + " " + ArithTypeNames[t]);
+    }
+
+    liveBase = base;
+    liveHeader = static_cast<LiveStatsHeader*>(base);
+    liveHeader->version = LIVE_STATS_VERSION;
+    liveHeader->maxThreads = maxThreads;
+    liveHeader->maxSlots = KnobMaxSlots.Value();
+    liveHeader->numThreads = 0;
+    liveHeader->numSlots = numSlots;
+    liveHeader->state = LIVE_RUNNING;
+    liveHeader->pid = PIN_GetPid();
+    liveHeader->exitCode = 0;
+    liveHeader->sampleMeanGap = sampleMode == SAMPLE_BBL ? sampleMeanGap : 1.0;
+    // La firma va última: un lector no acepta una cabecera a medio escribir
+    memcpy(liveHeader->magic, LIVE_STATS_MAGIC, sizeof(LIVE_STATS_MAGIC));
+    return true;
+}
+
 // Callback al finalizar
 VOID Fini(INT32 code, VOID *v) {
-    GenerateReport();
-    outFile.close();
+    MergeAllThreads();
+    ExpandBblCounts();
+    ExpandIpCounts();
+    ComputeTotals();
+
+    UINT64 observedTotal = 0;
+    for (const auto& entry : functionStatsMap) {
+        observedTotal += entry.second.totalArithInstructions;
+    }
+    EstimateSampledCounts(observedTotal);
+
+    if (ipProfileEnabled) {
+        WriteIpProfileFile();
+    }
+
+    if (profileFile == nullptr) {
+        GenerateReport();
+        if (KnobTrackCallHierarchy.Value()) {
+            GenerateContextReport();
+        }
+        if (icallEnabled) {
+            GenerateIcallReport();
+        }
+        outFile.close();
+    } else {
+        const string& format = KnobFormat.Value();
+        BinaryProfileSink binarySink(profileFile);
+        JsonProfileSink jsonSink(profileFile);
+        CsvProfileSink csvSink(profileFile);
+        ProfileSink& sink = format == "bin" ? static_cast<ProfileSink&>(binarySink) :
+                            format == "json" ? static_cast<ProfileSink&>(jsonSink) :
+                                               static_cast<ProfileSink&>(csvSink);
+        bool ok = WriteStructuredProfile(sink);
+        ok = fclose(profileFile) == 0 && ok;
+        if (!ok) {
+            std::cerr << "ERROR: No se pudo escribir " << KnobOutputFile.Value() << std::endl;
+        }
+    }
+
+    if (liveHeader != nullptr) {
+        liveHeader->exitCode = code;
+        liveHeader->state = LIVE_FINISHED;
+        msync(liveBase, LIVE_STATS_DATA_OFFSET, MS_SYNC);
+    }
 
     std::cerr << "Análisis completado. Resultados en: "
               << KnobOutputFile.Value() << std::endl;
@@ -502,10 +2187,30 @@ INT32 Usage() {
     std::cerr << std::endl;
     std::cerr << "Otras opciones:" << std::endl;
     std::cerr << "  -track 0/1  Rastrear jerarquía de llamadas (default: 1)" << std::endl;
+    std::cerr << "  -ctx_top <n> Contextos más calientes a reportar (default: 20)" << std::endl;
+    std::cerr << "  -bbl 0/1    Contar por bloque básico en lugar de por instrucción (default: 0)" << std::endl;
+    std::cerr << "  -slots <n>  Capacidad de contadores por thread (default: 4194304)" << std::endl;
+    std::cerr << "  -sample bbl|slice  Muestreo con conteos estimados e IC 95%" << std::endl;
+    std::cerr << "  -sample_period <n> Modo bbl: 1 de cada n ejecuciones de BBL (default: 1000)" << std::endl;
+    std::cerr << "  -max_slowdown <s>  Modo slice: slowdown objetivo (default: 5)" << std::endl;
+    std::cerr << "  -exact_slowdown <k> Modo slice: slowdown del modo exacto (default: 40)" << std::endl;
+    std::cerr << "  -slice_ms <ms>     Modo slice: rebanada instrumentada (default: 20)" << std::endl;
+    std::cerr << "  -roi 0/1    Contar solo entre CryptoInjectorRoiBegin/End (default: 0)" << std::endl;
+    std::cerr << "  -roi_start <rutina>  Abrir la región al entrar a la rutina" << std::endl;
+    std::cerr << "  -roi_stop <rutina>   Cerrar la región al entrar a la rutina" << std::endl;
+    std::cerr << "  -ip_profile <file> Conteos dinámicos por IP (binario, para el muestreo de sitios)" << std::endl;
+    std::cerr << "  -live <file>       Contadores en un archivo mapeado, legibles en vivo con statview" << std::endl;
+    std::cerr << "  -live_threads <n>  Threads con contadores en el archivo (default: 64)" << std::endl;
+    std::cerr << "  -icall 0/1  Destinos más frecuentes de cada llamada indirecta (default: 0)" << std::endl;
+    std::cerr << "  -lazy 0/1   Instrumentar rutinas al compilar su primer trace (default: 0)" << std::endl;
     std::cerr << "  -l 0/1      Incluir bibliotecas dinámicas (default: 0)" << std::endl;
     std::cerr << "  -v 0/1      Modo verbose (default: 0)" << std::endl;
     std::cerr << "  -f <func>   Filtrar función específica (repetible)" << std::endl;
+    std::cerr << "  -f_regex <re>    Filtrar funciones que encajan (., [], *, +, ?, ^, $; repetible)" << std::endl;
+    std::cerr << "  -f_exclude <sub> Excluir funciones cuyo nombre contiene <sub> (repetible)" << std::endl;
+    std::cerr << "              Los filtros se prueban sobre el nombre mangled y el demangled" << std::endl;
     std::cerr << "  -o <file>   Archivo de salida (default: arithmetic_profile.txt)" << std::endl;
+    std::cerr << "  -format text|bin|json|csv  Reporte legible o perfil estructurado (default: text)" << std::endl;
     std::cerr << std::endl;
     std::cerr << "Ejemplos de uso:" << std::endl;
     std::cerr << "  # Modo estricto (solo aritmética real):" << std::endl;
@@ -520,8 +2225,23 @@ INT32 Usage() {
     std::cerr << "  # Análisis de funciones específicas:" << std::endl;
     std::cerr << "  pin -t inst_counter.so -f main -f calculate -- ./programa" << std::endl;
     std::cerr << std::endl;
+    std::cerr << "  # Métodos de CryptoContextImpl (nombre demangled), sin serialización:" << std::endl;
+    std::cerr << "  pin -t inst_counter.so -f lbcrypto::CryptoContextImpl::Eval -f_exclude serial -- ./programa" << std::endl;
+    std::cerr << std::endl;
     std::cerr << "  # Sin rastreo de jerarquía (más rápido):" << std::endl;
     std::cerr << "  pin -t inst_counter.so -track 0 -- ./programa" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  # Conteo agregado por bloque básico (menos llamadas de análisis):" << std::endl;
+    std::cerr << "  pin -t inst_counter.so -bbl 1 -- ./programa" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  # Bootstrapping largo con estimación a lo sumo 5x más lento que nativo:" << std::endl;
+    std::cerr << "  pin -t inst_counter.so -sample slice -max_slowdown 5 -- ./programa" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  # Binarios grandes (OpenFHE): instrumentar solo las rutinas que corren:" << std::endl;
+    std::cerr << "  pin -t inst_counter.so -lazy 1 -- ./programa" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  # Contar solo dentro de Encrypt (sin KeyGen ni el contexto):" << std::endl;
+    std::cerr << "  pin -t inst_counter.so -roi_start Encrypt -- ./programa" << std::endl;
     return -1;
 }
 
@@ -534,8 +2254,20 @@ int main(int argc, char *argv[]) {
     }
 
     // Abrir archivo de salida
-    outFile.open(KnobOutputFile.Value().c_str());
-    if (!outFile.is_open()) {
+    const string& format = KnobFormat.Value();
+    if (format != "text" && format != "bin" && format != "json" && format != "csv") {
+        std::cerr << "Error: formato desconocido: " << format << std::endl;
+        return Usage();
+    }
+    bool opened;
+    if (format == "text") {
+        outFile.open(KnobOutputFile.Value().c_str());
+        opened = outFile.is_open();
+    } else {
+        profileFile = fopen(KnobOutputFile.Value().c_str(), format == "bin" ? "wb" : "w");
+        opened = profileFile != nullptr;
+    }
+    if (!opened) {
         std::cerr << "Error: No se pudo abrir el archivo de salida: "
                   << KnobOutputFile.Value() << std::endl;
         return -1;
@@ -543,19 +2275,82 @@ int main(int argc, char *argv[]) {
 
     // Procesar funciones de interés
     for (UINT32 i = 0; i < KnobFunctionFilter.NumberOfValues(); i++) {
-        functionsOfInterest.insert(KnobFunctionFilter.Value(i));
+        functionFilter.AddPattern(KnobFunctionFilter.Value(i));
         std::cerr << "Filtrando función: " << KnobFunctionFilter.Value(i) << std::endl;
     }
+    for (UINT32 i = 0; i < KnobFunctionRegex.NumberOfValues(); i++) {
+        const string& regex = KnobFunctionRegex.Value(i);
+        if (regex.empty()) {
+            continue;
+        }
+        if (!functionFilter.AddRegex(regex)) {
+            std::cerr << "Error: expresión regular inválida: " << regex << std::endl;
+            return Usage();
+        }
+        std::cerr << "Filtrando funciones que encajan con: " << regex << std::endl;
+    }
+    for (UINT32 i = 0; i < KnobFunctionExclude.NumberOfValues(); i++) {
+        functionFilter.AddExclude(KnobFunctionExclude.Value(i));
+    }
+    functionFilter.Compile();
 
-    if (functionsOfInterest.empty()) {
+    if (functionFilter.Empty()) {
         std::cerr << "Sin filtro de funciones. Instrumentando todas las funciones." << std::endl;
     }
 
+    // Muestreo (implica granularidad por bloque)
+    if (!ConfigureSampling()) {
+        return Usage();
+    }
+    bblGranularity = KnobBblMode.Value() || sampleMode != SAMPLE_NONE;
+    ipProfileEnabled = !KnobIpProfile.Value().empty();
+    lazyInstrumentation = KnobLazy.Value();
+    icallEnabled = KnobIcall.Value();
+
+    if (!KnobLive.Value().empty() && !OpenLiveStats(KnobLive.Value())) {
+        return -1;
+    }
+
+    // Región de interés: fuera de ella no se cuenta nada
+    roiEnabled = KnobRoi.Value() || !KnobRoiStart.Value().empty();
+    roiStartFilter.AddPattern(KnobRoiStart.Value());
+    roiStartFilter.Compile();
+    roiStopFilter.AddPattern(KnobRoiStop.Value());
+    roiStopFilter.Compile();
+    roiUntilReturn = !roiStartFilter.Empty() && roiStopFilter.Empty();
+    if (roiEnabled) {
+        roiActive = 0;
+        std::cerr << "Región de interés activada" << std::endl;
+    }
+    SelectAnalysisRoutines();
+
+    // Estado por thread: TLS y registro de herramienta para los contadores
+    PIN_InitLock(&threadsLock);
+    PIN_InitLock(&roiFrameLock);
+    tlsKey = PIN_CreateThreadDataKey(nullptr);
+    counterBaseReg = PIN_ClaimToolRegister();
+    if (!REG_valid(counterBaseReg)) {
+        std::cerr << "Error: no hay registros de herramienta disponibles" << std::endl;
+        return -1;
+    }
+
     // Registrar callbacks
+    PIN_AddThreadStartFunction(ThreadStart, 0);
+    PIN_AddThreadFiniFunction(ThreadFini, 0);
     IMG_AddInstrumentFunction(ImageLoad, 0);
     TRACE_AddInstrumentFunction(InstrumentTrace, 0);
     PIN_AddFiniFunction(Fini, 0);
 
+    if (sampleMode == SAMPLE_SLICE) {
+        THREADID controller = PIN_SpawnInternalThread(SliceController, nullptr, 0,
+                                                      &sliceControllerUid);
+        if (controller == INVALID_THREADID) {
+            std::cerr << "Error: no se pudo crear el thread de muestreo" << std::endl;
+            return -1;
+        }
+        PIN_AddPrepareForFiniFunction(PrepareForFini, 0);
+    }
+
     std::cerr << "Iniciando instrumentación..." << std::endl;
 
     // Iniciar el programa
@@ -0,0 +1,291 @@
+// Lector de los contadores en vivo de inst_counter (-live).
+//
+// Mapea el archivo de contadores en solo lectura, interpreta los slots con
+// el .meta y muestra los conteos por función y tipo sumando todos los
+// threads. Sirve con la herramienta corriendo (foto del momento, -w para
+// refrescar) o después de que el proceso murió: los conteos hasta ese
+// punto siguen en el archivo.
+
+#include "live_stats.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using std::string;
+using std::vector;
+
+// ============================================================================
+// ESTRUCTURAS DE DATOS
+// ============================================================================
+
+struct LiveFunction {
+    string name;
+    uint32_t firstSlot = 0;
+    vector<uint64_t> counts;    // por tipo
+    uint64_t total = 0;
+};
+
+struct LiveBbl {
+    uint32_t slot;
+    uint32_t function;
+    vector<uint64_t> histogram;
+};
+
+struct LiveSite {
+    uint32_t slot;
+    uint32_t function;
+    uint32_t type;
+};
+
+struct LiveMetadata {
+    vector<string> typeNames;
+    std::map<uint32_t, LiveFunction> functions;
+    vector<LiveBbl> bbls;
+    vector<LiveSite> sites;
+};
+
+// ============================================================================
+// LECTURA
+// ============================================================================
+
+// Solo líneas completas: la última puede estar a medio escribir
+bool LoadMetadata(const string& path, LiveMetadata& meta) {
+    std::ifstream in(path.c_str());
+    if (!in.is_open()) {
+        return false;
+    }
+    string line;
+    while (std::getline(in, line)) {
+        if (in.eof()) {
+            break;
+        }
+        std::istringstream ss(line);
+        char kind = 0;
+        ss >> kind;
+        if (kind == 'T') {
+            uint32_t type;
+            string name;
+            ss >> type >> name;
+            if (meta.typeNames.size() <= type) {
+                meta.typeNames.resize(type + 1);
+            }
+            meta.typeNames[type] = name;
+        } else if (kind == 'F') {
+            uint32_t id;
+            LiveFunction f;
+            ss >> id >> f.firstSlot;
+            ss.get();
+            std::getline(ss, f.name);
+            meta.functions[id] = f;
+        } else if (kind == 'B') {
+            LiveBbl b;
+            ss >> b.slot >> b.function;
+            uint64_t c;
+            while (ss >> c) {
+                b.histogram.push_back(c);
+            }
+            meta.bbls.push_back(b);
+        } else if (kind == 'S') {
+            LiveSite s;
+            ss >> s.slot >> s.function >> s.type;
+            meta.sites.push_back(s);
+        }
+    }
+    return true;
+}
+
+class LiveFile {
+public:
+    ~LiveFile() {
+        if (base != nullptr) {
+            munmap(base, size);
+        }
+    }
+
+    bool Open(const string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < LIVE_STATS_DATA_OFFSET) {
+            close(fd);
+            return false;
+        }
+        size = st.st_size;
+        void* m = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (m == MAP_FAILED) {
+            return false;
+        }
+        base = m;
+        header = static_cast<const LiveStatsHeader*>(base);
+        return std::memcmp(header->magic, LIVE_STATS_MAGIC, sizeof(LIVE_STATS_MAGIC)) == 0 &&
+               header->version == LIVE_STATS_VERSION &&
+               LiveStatsFileSize(header->maxThreads, header->maxSlots) <= size;
+    }
+
+    // Suma de un slot en todos los threads dados de alta
+    uint64_t Slot(uint32_t slot) const {
+        uint64_t sum = 0;
+        uint32_t threads = header->numThreads;
+        threads = std::min(threads, header->maxThreads);
+        for (uint32_t t = 0; t < threads; t++) {
+            sum += LiveThreadCounters(base, header, t)[slot];
+        }
+        return sum;
+    }
+
+    const LiveStatsHeader* Header() const { return header; }
+
+private:
+    void* base = nullptr;
+    size_t size = 0;
+    const LiveStatsHeader* header = nullptr;
+};
+
+// Reconstruir los conteos por función como lo hace Fini (ExpandBblCounts y
+// ExpandIpCounts), sin la estimación del muestreo por rebanadas
+void Accumulate(const LiveFile& live, LiveMetadata& meta) {
+    size_t numTypes = meta.typeNames.size();
+    uint32_t numSlots = live.Header()->numSlots;
+    double scale = live.Header()->sampleMeanGap;
+
+    for (auto& entry : meta.functions) {
+        LiveFunction& f = entry.second;
+        f.counts.assign(numTypes, 0);
+        for (size_t t = 0; t < numTypes && f.firstSlot + t < numSlots; t++) {
+            f.counts[t] = live.Slot(f.firstSlot + t);
+        }
+    }
+    for (const LiveBbl& b : meta.bbls) {
+        auto it = meta.functions.find(b.function);
+        if (it == meta.functions.end() || b.slot >= numSlots) {
+            continue;
+        }
+        uint64_t executions = static_cast<uint64_t>(live.Slot(b.slot) * scale);
+        for (size_t t = 0; t < numTypes && t < b.histogram.size(); t++) {
+            it->second.counts[t] += executions * b.histogram[t];
+        }
+    }
+    for (const LiveSite& s : meta.sites) {
+        auto it = meta.functions.find(s.function);
+        if (it != meta.functions.end() && s.slot < numSlots && s.type < numTypes) {
+            it->second.counts[s.type] += live.Slot(s.slot);
+        }
+    }
+    for (auto& entry : meta.functions) {
+        LiveFunction& f = entry.second;
+        f.total = 0;
+        for (uint64_t c : f.counts) {
+            f.total += c;
+        }
+    }
+}
+
+// ============================================================================
+// SALIDA
+// ============================================================================
+
+const char* StateName(const LiveStatsHeader* h) {
+    if (h->state == LIVE_FINISHED) {
+        return "terminado";
+    }
+    // Sigue en RUNNING pero el proceso ya no existe: murió sin llegar a Fini
+    if (kill(static_cast<pid_t>(h->pid), 0) != 0 && errno == ESRCH) {
+        return "interrumpido";
+    }
+    return "corriendo";
+}
+
+void PrintSnapshot(const LiveFile& live, const LiveMetadata& meta, size_t top) {
+    const LiveStatsHeader* h = live.Header();
+    std::cout << "pid=" << h->pid << " estado=" << StateName(h)
+              << " threads=" << h->numThreads << " slots=" << h->numSlots;
+    if (h->state == LIVE_FINISHED) {
+        std::cout << " exit_code=" << h->exitCode;
+    }
+    std::cout << std::endl;
+
+    vector<const LiveFunction*> sorted;
+    uint64_t total = 0;
+    for (const auto& entry : meta.functions) {
+        if (entry.second.total > 0) {
+            sorted.push_back(&entry.second);
+            total += entry.second.total;
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const LiveFunction* a, const LiveFunction* b) {
+        return a->total > b->total;
+    });
+
+    std::cout << "Total aritméticas: " << total << std::endl;
+    for (size_t i = 0; i < sorted.size() && i < top; i++) {
+        const LiveFunction* f = sorted[i];
+        std::cout << std::setw(16) << f->total << "  " << f->name << std::endl;
+        for (size_t t = 0; t < f->counts.size(); t++) {
+            if (f->counts[t] > 0) {
+                std::cout << std::setw(16) << "" << "    " << std::left << std::setw(14)
+                          << meta.typeNames[t] << std::right << f->counts[t] << std::endl;
+            }
+        }
+    }
+}
+
+int Usage() {
+    std::cerr << "Uso: statview <archivo -live> [opciones]" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  -n <n>      Funciones a mostrar (default: 20)" << std::endl;
+    std::cerr << "  -w <seg>    Refrescar cada <seg> segundos hasta que termine" << std::endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        return Usage();
+    }
+    string path = argv[1];
+    size_t top = 20;
+    unsigned watch = 0;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        string arg = argv[i];
+        if (arg == "-n") {
+            top = std::stoul(argv[i + 1]);
+        } else if (arg == "-w") {
+            watch = std::stoul(argv[i + 1]);
+        } else {
+            return Usage();
+        }
+    }
+
+    while (true) {
+        LiveFile live;
+        LiveMetadata meta;
+        if (!live.Open(path) || !LoadMetadata(path + ".meta", meta)) {
+            std::cerr << "ERROR: " << path << " no es un archivo -live de inst_counter" << std::endl;
+            return 1;
+        }
+        Accumulate(live, meta);
+        PrintSnapshot(live, meta, top);
+
+        if (watch == 0 || live.Header()->state == LIVE_FINISHED ||
+            string(StateName(live.Header())) == "interrumpido") {
+            break;
+        }
+        std::cout << std::endl;
+        sleep(watch);
+    }
+    return 0;
+}
@@ -1 +1,385 @@
 #include "utils_ckks.h"
+#include "common/roi_markers.h"
+#include <random>
+#include <cmath>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <immintrin.h>
+
+using namespace lbcrypto;
+
+// NativeInteger wraps a single 64-bit word, so a limb's coefficients can be
+// scanned as a plain uint64_t array instead of through element accessors.
+static_assert(sizeof(NativeInteger) == sizeof(uint64_t),
+              "NativeInteger must be a bare 64-bit word");
+
+const char* FaultOutcomeName(FaultOutcome outcome) {
+    switch (outcome) {
+        case OUTCOME_MASKED:         return "masked";
+        case OUTCOME_PRECISION_LOSS: return "precision_loss";
+        case OUTCOME_SDC:            return "sdc";
+    }
+    return "unknown";
+}
+
+// Count the differing words of one block that failed the fast equality
+// check. Returns the index of the first one.
+static int64_t AccumulateBlock(const uint64_t* a, const uint64_t* b, size_t begin,
+                               size_t end, CiphertextDiff& diff) {
+    int64_t first = -1;
+    for (size_t j = begin; j < end; j++) {
+        uint64_t w = a[j] ^ b[j];
+        if (w != 0) {
+            if (first < 0) {
+                first = static_cast<int64_t>(j);
+            }
+            diff.differingCoefficients++;
+            diff.hammingDistance += __builtin_popcountll(w);
+        }
+    }
+    return first;
+}
+
+// Words per block of the equality scan: a fault-free block costs one
+// OR-reduction and one branch.
+static const size_t COMPARE_BLOCK = 8;
+
+// Baseline x86-64 (SSE2) scan. The block reduction has no early exit, so
+// the compiler vectorizes it.
+static int64_t CompareWordsGeneric(const uint64_t* a, const uint64_t* b, size_t n,
+                                   CiphertextDiff& diff) {
+    int64_t first = -1;
+    size_t i = 0;
+    for (; i + COMPARE_BLOCK <= n; i += COMPARE_BLOCK) {
+        uint64_t x = 0;
+        for (size_t j = 0; j < COMPARE_BLOCK; j++) {
+            x |= a[i + j] ^ b[i + j];
+        }
+        if (x == 0) {
+            continue;
+        }
+        int64_t f = AccumulateBlock(a, b, i, i + COMPARE_BLOCK, diff);
+        if (first < 0) {
+            first = f;
+        }
+    }
+    int64_t f = AccumulateBlock(a, b, i, n, diff);
+    return first >= 0 ? first : f;
+}
+
+// AVX2 scan: two 256-bit XORs and one VPTEST per block. Compiled for AVX2
+// regardless of -march and only called when the CPU supports it.
+__attribute__((target("avx2")))
+static int64_t CompareWordsAvx2(const uint64_t* a, const uint64_t* b, size_t n,
+                                CiphertextDiff& diff) {
+    int64_t first = -1;
+    size_t i = 0;
+    for (; i + COMPARE_BLOCK <= n; i += COMPARE_BLOCK) {
+        __m256i x0 = _mm256_xor_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        __m256i x1 = _mm256_xor_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 4)),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 4)));
+        __m256i x = _mm256_or_si256(x0, x1);
+        if (_mm256_testz_si256(x, x)) {
+            continue;
+        }
+        int64_t f = AccumulateBlock(a, b, i, i + COMPARE_BLOCK, diff);
+        if (first < 0) {
+            first = f;
+        }
+    }
+    int64_t f = AccumulateBlock(a, b, i, n, diff);
+    return first >= 0 ? first : f;
+}
+
+// Accumulate differences between two word arrays into diff. Returns the
+// index of the first differing word, or -1 if they are equal. The AVX2
+// scan is picked once, from the running CPU.
+static int64_t CompareWords(const uint64_t* a, const uint64_t* b, size_t n,
+                            CiphertextDiff& diff) {
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2 ? CompareWordsAvx2(a, b, n, diff) : CompareWordsGeneric(a, b, n, diff);
+}
+
+CiphertextDiff CompareCiphertexts(const Ciphertext<DCRTPoly>& faulty,
+                                  const Ciphertext<DCRTPoly>& golden) {
+    CiphertextDiff diff;
+
+    const auto& elems1 = faulty->GetElements();
+    const auto& elems2 = golden->GetElements();
+
+    if (elems1.size() != elems2.size() ||
+        faulty->GetLevel() != golden->GetLevel() ||
+        faulty->GetNoiseScaleDeg() != golden->GetNoiseScaleDeg()) {
+        diff.identical = false;
+        diff.shapeMismatch = true;
+        return diff;
+    }
+
+    for (size_t e = 0; e < elems1.size(); e++) {
+        const auto& limbs1 = elems1[e].GetAllElements();
+        const auto& limbs2 = elems2[e].GetAllElements();
+
+        if (limbs1.size() != limbs2.size() ||
+            elems1[e].GetFormat() != elems2[e].GetFormat()) {
+            diff.identical = false;
+            diff.shapeMismatch = true;
+            return diff;
+        }
+
+        for (size_t l = 0; l < limbs1.size(); l++) {
+            const auto& v1 = limbs1[l].GetValues();
+            const auto& v2 = limbs2[l].GetValues();
+            size_t n = v1.GetLength();
+
+            if (n != v2.GetLength()) {
+                diff.identical = false;
+                diff.shapeMismatch = true;
+                return diff;
+            }
+            if (n == 0) {
+                continue;
+            }
+
+            const uint64_t* w1 = reinterpret_cast<const uint64_t*>(&v1[0]);
+            const uint64_t* w2 = reinterpret_cast<const uint64_t*>(&v2[0]);
+            int64_t first = CompareWords(w1, w2, n, diff);
+            if (first >= 0 && diff.firstElement < 0) {
+                diff.firstElement = static_cast<int64_t>(e);
+                diff.firstLimb = static_cast<int64_t>(l);
+                diff.firstCoefficient = first;
+            }
+        }
+    }
+
+    diff.identical = diff.differingCoefficients == 0;
+    return diff;
+}
+
+std::vector<double> DecryptReal(const CryptoContext<DCRTPoly>& cc,
+                                const PrivateKey<DCRTPoly>& sk,
+                                const Ciphertext<DCRTPoly>& ct,
+                                size_t slots) {
+    Plaintext result;
+    cc->Decrypt(sk, ct, &result);
+    result->SetLength(slots);
+
+    std::vector<double> values;
+    values.reserve(slots);
+    for (const auto& v : result->GetCKKSPackedValue()) {
+        values.push_back(v.real());
+    }
+    return values;
+}
+
+FaultOutcome ClassifyFault(const CryptoContext<DCRTPoly>& cc,
+                           const PrivateKey<DCRTPoly>& sk,
+                           const Ciphertext<DCRTPoly>& faulty,
+                           const Ciphertext<DCRTPoly>& golden,
+                           const std::vector<double>& goldenValues,
+                           double tolerance,
+                           CiphertextDiff* diff) {
+    CiphertextDiff d = CompareCiphertexts(faulty, golden);
+    if (diff != nullptr) {
+        *diff = d;
+    }
+    if (d.identical) {
+        return OUTCOME_MASKED;
+    }
+
+    // A corrupted ciphertext may not even decrypt (e.g. approximation error
+    // too high); that is still silent corruption of the result
+    std::vector<double> values;
+    try {
+        values = DecryptReal(cc, sk, faulty, goldenValues.size());
+    } catch (const std::exception&) {
+        return OUTCOME_SDC;
+    }
+    if (values.size() != goldenValues.size()) {
+        return OUTCOME_SDC;
+    }
+
+    for (size_t i = 0; i < values.size(); i++) {
+        double err = std::fabs(values[i] - goldenValues[i]);
+        if (!(err <= tolerance)) {  // NaN counts as corruption
+            return OUTCOME_SDC;
+        }
+    }
+    return OUTCOME_PRECISION_LOSS;
+}
+
+void RegisterCiphertextBuffers(const Ciphertext<DCRTPoly>& ct) {
+    CryptoInjectorClearBuffers();
+    for (const auto& element : ct->GetElements()) {
+        for (const auto& limb : element.GetAllElements()) {
+            const auto& values = limb.GetValues();
+            if (values.GetLength() > 0) {
+                CryptoInjectorRegisterBuffer(&values[0], values.GetLength() * sizeof(uint64_t));
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Harness
+// ============================================================================
+
+std::vector<PipelineOp> ParsePipeline(const std::string& spec) {
+    std::vector<PipelineOp> pipeline;
+    std::stringstream ss(spec);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        if (token.empty()) {
+            continue;
+        }
+        PipelineOp op{PIPELINE_ENCRYPT};
+        std::string name = token.substr(0, token.find(':'));
+        if (name == "encrypt") {
+            op.type = PIPELINE_ENCRYPT;
+        } else if (name == "mult") {
+            op.type = PIPELINE_EVAL_MULT;
+        } else if (name == "add") {
+            op.type = PIPELINE_EVAL_ADD;
+        } else if (name == "rescale") {
+            op.type = PIPELINE_RESCALE;
+        } else if (name == "rotate") {
+            op.type = PIPELINE_EVAL_ROTATE;
+            size_t colon = token.find(':');
+            op.rotation = colon == std::string::npos ? 1 : std::stoi(token.substr(colon + 1));
+        } else {
+            throw std::invalid_argument("unknown pipeline operation: " + token);
+        }
+        pipeline.push_back(op);
+    }
+    return pipeline;
+}
+
+KeyPair<DCRTPoly> GeneratePipelineKeys(const CryptoContext<DCRTPoly>& cc,
+                                       const std::vector<PipelineOp>& pipeline) {
+    KeyPair<DCRTPoly> keys = cc->KeyGen();
+
+    std::vector<int32_t> rotations;
+    bool needsMult = false;
+    for (const PipelineOp& op : pipeline) {
+        needsMult |= op.type == PIPELINE_EVAL_MULT;
+        if (op.type == PIPELINE_EVAL_ROTATE) {
+            rotations.push_back(op.rotation);
+        }
+    }
+    if (needsMult) {
+        cc->EvalMultKeyGen(keys.secretKey);
+    }
+    if (!rotations.empty()) {
+        cc->EvalRotateKeyGen(keys.secretKey, rotations);
+    }
+    return keys;
+}
+
+Ciphertext<DCRTPoly> ApplyPipelineOp(const CryptoContext<DCRTPoly>& cc,
+                                     const PublicKey<DCRTPoly>& publicKey,
+                                     const Plaintext& plaintext,
+                                     const PipelineOp& op,
+                                     const Ciphertext<DCRTPoly>& ct) {
+    switch (op.type) {
+        case PIPELINE_ENCRYPT:
+            return cc->Encrypt(publicKey, plaintext);
+        case PIPELINE_EVAL_MULT:
+            return cc->EvalMult(ct, ct);
+        case PIPELINE_EVAL_ADD:
+            return cc->EvalAdd(ct, ct);
+        case PIPELINE_RESCALE:
+            return cc->Rescale(ct);
+        case PIPELINE_EVAL_ROTATE:
+            return cc->EvalRotate(ct, op.rotation);
+    }
+    throw std::invalid_argument("unknown pipeline operation");
+}
+
+ScalingTechnique ParseScalingTechnique(const std::string& name) {
+    if (name == "FIXEDMANUAL") {
+        return FIXEDMANUAL;
+    } else if (name == "FIXEDAUTO") {
+        return FIXEDAUTO;
+    } else if (name == "FLEXIBLEAUTO") {
+        return FLEXIBLEAUTO;
+    } else if (name == "FLEXIBLEAUTOEXT") {
+        return FLEXIBLEAUTOEXT;
+    }
+    throw std::invalid_argument("unknown scaling technique: " + name);
+}
+
+CkksHarness::CkksHarness(const HarnessConfig& cfg) : config(cfg) {
+    CCParams<CryptoContextCKKSRNS> parameters;
+    parameters.SetMultiplicativeDepth(config.multDepth);
+    parameters.SetScalingModSize(config.scaleMod);
+    parameters.SetFirstModSize(config.firstMod);
+    parameters.SetBatchSize(config.batchSize);
+    parameters.SetRingDim(config.ringDim);
+    parameters.SetScalingTechnique(config.scalingTechnique);
+    parameters.SetSecurityLevel(HEStd_NotSet);
+
+    cc = GenCryptoContext(parameters);
+    cc->Enable(PKE);
+    cc->Enable(KEYSWITCH);
+    cc->Enable(LEVELEDSHE);
+
+    keys = GeneratePipelineKeys(cc, config.pipeline);
+
+    plaintext = cc->MakeCKKSPackedPlaintext(config.input);
+
+    PseudoRandomNumberGenerator::GetPRNG().SetSeed(config.seed);
+    golden = RunPipeline();
+    goldenValues = DecryptReal(cc, keys.secretKey, golden, config.input.size());
+}
+
+Ciphertext<DCRTPoly> CkksHarness::RunPipeline() {
+    PseudoRandomNumberGenerator::GetPRNG().ResetToSeed();
+
+    // Without an explicit encrypt first, the pipeline starts from a fresh encryption
+    Ciphertext<DCRTPoly> ct;
+    if (config.pipeline.empty() || config.pipeline[0].type != PIPELINE_ENCRYPT) {
+        ct = cc->Encrypt(keys.publicKey, plaintext);
+        RegisterCiphertextBuffers(ct);
+    }
+
+    for (const PipelineOp& op : config.pipeline) {
+        ct = ApplyPipelineOp(cc, keys.publicKey, plaintext, op, ct);
+        RegisterCiphertextBuffers(ct);
+    }
+    return ct;
+}
+
+IterationResult CkksHarness::RunIteration(uint64_t iteration) {
+    CryptoInjectorIterationBoundary(iteration);
+
+    IterationResult result;
+    result.iteration = iteration;
+    try {
+        Ciphertext<DCRTPoly> ct = RunPipeline();
+        result.outcome = ClassifyFault(cc, keys.secretKey, ct, golden, goldenValues,
+                                       config.tolerance, &result.diff);
+    } catch (const std::exception&) {
+        // An OpenFHE consistency check caught the corruption
+        result.outcome = OUTCOME_SDC;
+        result.diff.identical = false;
+        result.diff.shapeMismatch = true;
+    }
+    return result;
+}
+
+void CkksHarness::Run(uint64_t iterations, std::ostream& out) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        IterationResult r = RunIteration(i);
+        out << "id=" << r.iteration
+            << " outcome=" << FaultOutcomeName(r.outcome)
+            << " hamming=" << r.diff.hammingDistance
+            << " coefficients=" << r.diff.differingCoefficients
+            << " first_element=" << r.diff.firstElement
+            << " first_limb=" << r.diff.firstLimb
+            << " first_coefficient=" << r.diff.firstCoefficient
+            << std::endl;
+    }
+}
@@ -1 +1,157 @@
-#include <random>
+#ifndef UTILS_CKKS_H
+#define UTILS_CKKS_H
+
+#include "openfhe.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Result of a full comparison between a faulty and a golden ciphertext.
+// Positions are only meaningful when identical == false.
+struct CiphertextDiff {
+    bool identical = true;
+    bool shapeMismatch = false;       // element/limb count, ring size or metadata differ
+    uint64_t differingCoefficients = 0;
+    uint64_t hammingDistance = 0;     // flipped bits across all limbs
+    int64_t firstElement = -1;        // index of the first differing DCRTPoly
+    int64_t firstLimb = -1;           // first differing RNS limb in that element
+    int64_t firstCoefficient = -1;
+};
+
+enum FaultOutcome {
+    OUTCOME_MASKED,          // ciphertext bit-identical to the golden one
+    OUTCOME_PRECISION_LOSS,  // decrypts within tolerance of the golden values
+    OUTCOME_SDC              // silent data corruption: wrong values or undecryptable
+};
+
+const char* FaultOutcomeName(FaultOutcome outcome);
+
+// Compare every coefficient of every limb of every element. The common case
+// (no difference) is a vectorized equality scan over the raw 64-bit words:
+// AVX2 when the running CPU has it, whatever -march the file was built with,
+// and SSE2 otherwise. Only blocks that differ pay for the popcount.
+CiphertextDiff CompareCiphertexts(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& faulty,
+                                  const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& golden);
+
+// Decrypt and return the first `slots` real values
+std::vector<double> DecryptReal(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                                const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& sk,
+                                const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& ct,
+                                size_t slots);
+
+// Classify a faulty ciphertext against the golden ciphertext and its
+// decrypted values. Decryption only happens when the ciphertexts differ.
+// `diff`, if given, receives the raw comparison.
+FaultOutcome ClassifyFault(const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+                           const lbcrypto::PrivateKey<lbcrypto::DCRTPoly>& sk,
+                           const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& faulty,
+                           const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& golden,
+                           const std::vector<double>& goldenValues,
+                           double tolerance,
+                           CiphertextDiff* diff = nullptr);
+
+// Register every limb of every element of `ct` as a fault target for
+// FaultInjector -target buffer (replaces previously registered buffers)
+void RegisterCiphertextBuffers(const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& ct);
+
+// ============================================================================
+// In-process multi-injection harness
+// ============================================================================
+//
+// Builds the CKKS context and keys once, then replays the same operation
+// pipeline many times under a fixed PRNG seed (PRNG::ResetToSeed), so every
+// fault-free replay is bit-identical to the golden one. Each replay starts
+// with CryptoInjectorIterationBoundary(i), which FaultInjector -per_iteration
+// uses to arm the fault for that iteration: thousands of faults run in one
+// process, with no process startup and no Pin re-JIT per fault.
+//
+// After every pipeline operation the live ciphertext's limbs are registered
+// as buffers, so -target buffer faults land in the data being processed.
+//
+// Faults that corrupt state kept across iterations (keys, precomputed
+// tables) leak into later replays; restrict injection (-f) to the pipeline
+// operations.
+
+enum PipelineOpType {
+    PIPELINE_ENCRYPT,
+    PIPELINE_EVAL_MULT,   // squares the current ciphertext (relinearized)
+    PIPELINE_EVAL_ADD,    // doubles the current ciphertext
+    PIPELINE_RESCALE,
+    PIPELINE_EVAL_ROTATE
+};
+
+struct PipelineOp {
+    PipelineOpType type;
+    int32_t rotation = 0;
+};
+
+// Parse a comma-separated pipeline, e.g. "encrypt,mult,rescale,rotate:1".
+// Throws std::invalid_argument on unknown operations.
+std::vector<PipelineOp> ParsePipeline(const std::string& spec);
+
+// Generate the key pair plus the relinearization and rotation keys that
+// `pipeline` needs
+lbcrypto::KeyPair<lbcrypto::DCRTPoly> GeneratePipelineKeys(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+    const std::vector<PipelineOp>& pipeline);
+
+// Apply one pipeline operation to `ct`; PIPELINE_ENCRYPT replaces it with a
+// fresh encryption of `plaintext`
+lbcrypto::Ciphertext<lbcrypto::DCRTPoly> ApplyPipelineOp(
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& cc,
+    const lbcrypto::PublicKey<lbcrypto::DCRTPoly>& publicKey,
+    const lbcrypto::Plaintext& plaintext,
+    const PipelineOp& op,
+    const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& ct);
+
+// Parse a scaling technique by its OpenFHE name (FIXEDMANUAL, FIXEDAUTO,
+// FLEXIBLEAUTO, FLEXIBLEAUTOEXT). Throws std::invalid_argument otherwise.
+lbcrypto::ScalingTechnique ParseScalingTechnique(const std::string& name);
+
+struct HarnessConfig {
+    uint32_t multDepth = 3;
+    uint32_t ringDim = 1 << 4;
+    uint32_t firstMod = 60;
+    uint32_t scaleMod = 59;
+    uint32_t batchSize = 4;
+    lbcrypto::ScalingTechnique scalingTechnique = lbcrypto::FIXEDMANUAL;
+    uint64_t seed = 1;
+    double tolerance = 1e-6;
+    std::vector<double> input = {0, 0.25, 0.75, 1};
+    std::vector<PipelineOp> pipeline = {{PIPELINE_ENCRYPT}};
+};
+
+struct IterationResult {
+    uint64_t iteration;
+    FaultOutcome outcome;
+    CiphertextDiff diff;
+};
+
+class CkksHarness {
+public:
+    explicit CkksHarness(const HarnessConfig& config);
+
+    // One replay of the pipeline from the fixed seed
+    lbcrypto::Ciphertext<lbcrypto::DCRTPoly> RunPipeline();
+
+    // Iteration boundary, replay, and classification against the golden run
+    IterationResult RunIteration(uint64_t iteration);
+
+    // Run `iterations` replays, writing one key=value line per iteration
+    void Run(uint64_t iterations, std::ostream& out);
+
+    const lbcrypto::CryptoContext<lbcrypto::DCRTPoly>& Context() const { return cc; }
+    const lbcrypto::Ciphertext<lbcrypto::DCRTPoly>& Golden() const { return golden; }
+
+private:
+    HarnessConfig config;
+    lbcrypto::CryptoContext<lbcrypto::DCRTPoly> cc;
+    lbcrypto::KeyPair<lbcrypto::DCRTPoly> keys;
+    lbcrypto::Plaintext plaintext;
+    lbcrypto::Ciphertext<lbcrypto::DCRTPoly> golden;
+    std::vector<double> goldenValues;
+};
+
+#endif // UTILS_CKKS_H
@@ -0,0 +1,487 @@
+// Pruebas de los headers de src/common que no dependen de Pin.
+//
+// Programa simple, sin framework: cada CHECK fallido se informa con su
+// línea y el programa termina con código 1 si hubo alguno.
+//   make && ./test_common
+
+#include "alias_sampler.h"
+#include "decision_cache.h"
+#include "function_filter.h"
+#include "ip_profile.h"
+#include "profile_format.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": falló " #cond     \
+                      << std::endl;                                          \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+// Archivo temporal propio de este proceso
+static std::string TempPath(const std::string& name) {
+    return "/tmp/test_common." + std::to_string(getpid()) + "." + name;
+}
+
+static std::string ReadFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+static void WriteFile(const std::string& path, const std::string& data) {
+    std::ofstream out(path, std::ios::binary);
+    out << data;
+}
+
+// ============================================================================
+// FILTRO DE FUNCIONES (-f, -f_regex, -f_exclude)
+// ============================================================================
+
+static void TestSubstringFilter() {
+    FunctionFilter filter;
+    CHECK(filter.Empty());
+    CHECK(filter.Matches("cualquiera"));
+
+    filter.AddPattern("EvalMult");
+    filter.AddPattern("Encrypt");
+    filter.Compile();
+    CHECK(!filter.Empty());
+    CHECK(filter.Matches("EvalMult"));
+    CHECK(filter.Matches("EvalMultKeyGen"));
+    CHECK(filter.Matches("_ZN8lbcrypto7EncryptEv"));
+    CHECK(!filter.Matches("Decrypt"));
+    CHECK(!filter.Matches(""));
+}
+
+static void TestDemangledNames() {
+    FunctionFilter filter;
+    filter.AddPattern("lbcrypto::CryptoContextImpl::EvalMult");
+    filter.Compile();
+
+    // Se prueba el nombre sin argumentos de template
+    std::string mangled = "_ZNK8lbcrypto17CryptoContextImplINS_11DCRTPolyImplEE8EvalMultE";
+    std::string demangled =
+        "lbcrypto::CryptoContextImpl<lbcrypto::DCRTPolyImpl<bigintdyn::mubintvec>>::EvalMult(int) const";
+    CHECK(filter.Matches(mangled, demangled));
+    CHECK(!filter.Matches(mangled, "lbcrypto::CryptoContextImpl<int>::EvalAdd(int) const"));
+    CHECK(StripTemplateArgs("a<b<c>>::f<d>(int)") == "a::f(int)");
+    CHECK(StripTemplateArgs("operator<(int)") == "operator<(int)");
+}
+
+static void TestRegexFilter() {
+    FunctionFilter filter;
+    CHECK(filter.AddRegex("^lbcrypto::.*::EvalMult$"));
+    CHECK(filter.AddRegex("Rescale\\d+"));
+    CHECK(filter.AddRegex("^[A-Z]\\w*Key[^G]"));
+    CHECK(!filter.AddRegex("[abc"));
+    CHECK(!filter.AddRegex("*x"));
+    filter.Compile();
+
+    CHECK(filter.Matches("lbcrypto::CryptoContextImpl::EvalMult"));
+    CHECK(!filter.Matches("lbcrypto::CryptoContextImpl::EvalMultKeyGen"));
+    CHECK(!filter.Matches("x::lbcrypto::a::EvalMult"));
+    CHECK(filter.Matches("DoRescale12"));
+    CHECK(!filter.Matches("DoRescale"));
+    CHECK(filter.Matches("EvalKeySwitch"));
+    CHECK(!filter.Matches("EvalKeyGen"));
+    CHECK(!filter.Matches("evalKeySwitch"));
+
+    NameRegex optional;
+    CHECK(optional.Compile("^ab?c+$"));
+    CHECK(optional.Search("ac"));
+    CHECK(optional.Search("abccc"));
+    CHECK(!optional.Search("abbc"));
+    CHECK(!optional.Search("ab"));
+}
+
+static void TestExcludeFilter() {
+    FunctionFilter filter;
+    filter.AddPattern("Eval");
+    filter.AddExclude("Serial");
+    filter.Compile();
+    CHECK(filter.Matches("EvalAdd"));
+    CHECK(!filter.Matches("EvalAddSerialize"));
+    CHECK(!filter.Matches("Decrypt"));
+
+    // Solo exclusiones: todo lo demás interesa
+    FunctionFilter excludeOnly;
+    excludeOnly.AddExclude("Serial");
+    excludeOnly.Compile();
+    CHECK(excludeOnly.Matches("EvalAdd"));
+    CHECK(!excludeOnly.Matches("Serialize"));
+
+    // La exclusión gana aunque solo aparezca en el nombre demangled
+    CHECK(!filter.Matches("_ZN4EvalE", "Eval(Serializer&)"));
+}
+
+// ============================================================================
+// PERFIL ESTRUCTURADO (-format bin|json|csv)
+// ============================================================================
+
+// Una fila por tabla, con nombres que necesitan escape en JSON y en CSV
+static bool WriteSampleProfile(ProfileSink& sink) {
+    ProfileHeader summary = {};
+    summary.numTypes = 2;
+    summary.sampling = PROFILE_SAMPLE_BBL;
+    summary.total = 1234;
+    summary.sampleScale = 8.5;
+    summary.globalBound = 12.25;
+    sink.Begin(summary);
+
+    sink.BeginTable(PROFILE_TYPES);
+    sink.Type(0, "ADD", 1000);
+    sink.Type(3, "DIV", 234);
+    sink.EndTable();
+
+    sink.BeginTable(PROFILE_FUNCTIONS);
+    ProfileFunctionRecord f = {0x401000, 1200, 3.5, 0, 0};
+    sink.Function(f, "lbcrypto::Eval<int, \"q\">(a, b)");
+    ProfileFunctionRecord g = {0x402000, 34, 0, 1, 0};
+    sink.Function(g, "main");
+    sink.EndTable();
+
+    sink.BeginTable(PROFILE_FUNCTION_TYPES);
+    sink.FunctionType({0, 0, 1000});
+    sink.FunctionType({0, 3, 200});
+    sink.FunctionType({1, 3, 34});
+    sink.EndTable();
+
+    sink.BeginTable(PROFILE_IMAGES);
+    sink.Image(0, "/lib/libOPENFHEpke.so");
+    sink.EndTable();
+
+    sink.BeginTable(PROFILE_IPS);
+    sink.Ip({0x1a0, 1000, 0, 0, 0, 0});
+    sink.EndTable();
+
+    sink.BeginTable(PROFILE_CONTEXTS);
+    sink.Context({0, 0, 1, 0, 34});
+    sink.Context({1, 0, 0, 1, 1200});
+    sink.EndTable();
+
+    sink.BeginTable(PROFILE_ICALLS);
+    ProfileIcallRecord call = {0x401020, 0x7f0000001000, 17, 0, 0};
+    sink.Icall(call, "vtable target, \"virtual\"");
+    sink.EndTable();
+    return sink.End();
+}
+
+// Exportar un perfil binario da lo mismo que escribir el formato directo
+static void TestProfileRoundTrip() {
+    std::string binPath = TempPath("prof.bin");
+    FILE* bin = std::fopen(binPath.c_str(), "wb");
+    CHECK(bin != nullptr);
+    if (bin == nullptr) {
+        return;
+    }
+    BinaryProfileSink binSink(bin);
+    CHECK(WriteSampleProfile(binSink));
+    CHECK(std::fclose(bin) == 0);
+
+    ProfileView view;
+    CHECK(view.Open(binPath));
+    CHECK(view.Header().total == 1234);
+    CHECK(view.Rows(PROFILE_FUNCTIONS) == 2);
+    CHECK(view.Rows(PROFILE_ICALLS) == 1);
+    const ProfileFunctionRecord* f = view.Row<ProfileFunctionRecord>(PROFILE_FUNCTIONS, 0);
+    CHECK(f != nullptr && std::string(view.String(f->name)) == "lbcrypto::Eval<int, \"q\">(a, b)");
+    CHECK(view.Row<ProfileFunctionRecord>(PROFILE_FUNCTIONS, 2) == nullptr);
+
+    for (const char* format : {"json", "csv"}) {
+        std::string directPath = TempPath(std::string("direct.") + format);
+        std::string replayPath = TempPath(std::string("replay.") + format);
+        FILE* direct = std::fopen(directPath.c_str(), "w");
+        FILE* replay = std::fopen(replayPath.c_str(), "w");
+        CHECK(direct != nullptr && replay != nullptr);
+        if (direct == nullptr || replay == nullptr) {
+            return;
+        }
+        if (std::string(format) == "json") {
+            JsonProfileSink directSink(direct);
+            JsonProfileSink replaySink(replay);
+            CHECK(WriteSampleProfile(directSink));
+            CHECK(ReplayProfile(view, replaySink));
+        } else {
+            CsvProfileSink directSink(direct);
+            CsvProfileSink replaySink(replay);
+            CHECK(WriteSampleProfile(directSink));
+            CHECK(ReplayProfile(view, replaySink));
+        }
+        std::fclose(direct);
+        std::fclose(replay);
+
+        std::string expected = ReadFile(directPath);
+        CHECK(!expected.empty());
+        CHECK(ReadFile(replayPath) == expected);
+        std::remove(directPath.c_str());
+        std::remove(replayPath.c_str());
+    }
+    std::remove(binPath.c_str());
+}
+
+// Un perfil dañado se rechaza en Open, antes de que un lector lo recorra
+static void TestCorruptProfile() {
+    std::string binPath = TempPath("prof.bin");
+    FILE* bin = std::fopen(binPath.c_str(), "wb");
+    CHECK(bin != nullptr);
+    if (bin == nullptr) {
+        return;
+    }
+    BinaryProfileSink binSink(bin);
+    CHECK(WriteSampleProfile(binSink));
+    CHECK(std::fclose(bin) == 0);
+    const std::string good = ReadFile(binPath);
+
+    // Primera tabla (tipos) justo después de la cabecera
+    const size_t tableOffset = sizeof(ProfileHeader);
+    std::string badPath = TempPath("prof.bad");
+    ProfileView view;
+
+    // Mismos bytes vistos como el doble de registros de la mitad de tamaño:
+    // la tabla entra en el archivo pero Row() no podría leer sus filas
+    std::string shortRecords = good;
+    uint32_t recordSize = sizeof(ProfileTypeRecord) / 2;
+    uint64_t doubledRows = 4;
+    std::memcpy(&shortRecords[tableOffset + offsetof(ProfileTableHeader, recordSize)],
+                &recordSize, sizeof(recordSize));
+    std::memcpy(&shortRecords[tableOffset + offsetof(ProfileTableHeader, rows)],
+                &doubledRows, sizeof(doubledRows));
+    WriteFile(badPath, shortRecords);
+    CHECK(!view.Open(badPath));
+
+    std::string tooManyRows = good;
+    uint64_t rows = UINT64_MAX / 2;
+    std::memcpy(&tooManyRows[tableOffset + offsetof(ProfileTableHeader, rows)],
+                &rows, sizeof(rows));
+    WriteFile(badPath, tooManyRows);
+    CHECK(!view.Open(badPath));
+
+    WriteFile(badPath, good.substr(0, good.size() - 1));
+    CHECK(!view.Open(badPath));
+
+    std::string badMagic = good;
+    badMagic[0] = 'X';
+    WriteFile(badPath, badMagic);
+    CHECK(!view.Open(badPath));
+
+    WriteFile(badPath, good);
+    CHECK(view.Open(badPath));
+
+    std::remove(badPath.c_str());
+    std::remove(binPath.c_str());
+}
+
+// ============================================================================
+// PERFIL POR IP Y SORTEO DE SITIOS (-ip_profile, run_campaign --profile)
+// ============================================================================
+
+// Las frecuencias observadas siguen a los pesos y un peso 0 nunca sale
+static void TestAliasProportions() {
+    std::vector<uint64_t> weights = {1, 2, 3, 0, 4, 1000000};
+    AliasSampler sampler(weights);
+    CHECK(sampler.Size() == weights.size());
+
+    const uint64_t draws = 2000000;
+    double total = 0;
+    for (uint64_t w : weights) {
+        total += w;
+    }
+    std::vector<uint64_t> hits(weights.size(), 0);
+    SplitMix64 rng(42);
+    for (uint64_t i = 0; i < draws; i++) {
+        hits[sampler.Sample(rng)]++;
+    }
+    CHECK(hits[3] == 0);
+    for (size_t i = 0; i < weights.size(); i++) {
+        // 5 desvíos estándar de la binomial, más uno por los pesos chicos
+        double p = weights[i] / total;
+        double expected = draws * p;
+        double tolerance = 5 * std::sqrt(draws * p * (1 - p)) + 1;
+        CHECK(std::fabs(hits[i] - expected) <= tolerance);
+    }
+
+    // Sin ejecuciones en el perfil todos los sitios valen lo mismo
+    AliasSampler uniform(std::vector<uint64_t>(4, 0));
+    std::vector<uint64_t> uniformHits(4, 0);
+    for (uint64_t i = 0; i < 400000; i++) {
+        uniformHits[uniform.Sample(rng)]++;
+    }
+    for (uint64_t h : uniformHits) {
+        CHECK(h > 99000 && h < 101000);
+    }
+
+    for (uint64_t n : {1ULL, 7ULL, 1ULL << 40}) {
+        for (int i = 0; i < 1000; i++) {
+            CHECK(rng.Below(n) < n);
+        }
+    }
+}
+
+// La instancia sorteada siempre existe en la IP elegida
+static void TestSampleSite() {
+    IpProfile profile;
+    profile.images.push_back("/lib/libOPENFHEcore.so");
+    profile.records.push_back({0x10, 3, 0, 0, IP_DEST_REG});
+    profile.records.push_back({0x20, 1, 0, 0, IP_DEST_REG | IP_DEST_MEM});
+    profile.records.push_back({0x30, 0, 0, 0, IP_DEST_MEM});
+    AliasSampler sampler = BuildSiteSampler(profile);
+
+    SplitMix64 rng(7);
+    for (int i = 0; i < 100000; i++) {
+        SampledSite site = SampleSite(sampler, profile, rng);
+        CHECK(site.record < 2);
+        CHECK(site.instance >= 1 && site.instance <= profile.records[site.record].count);
+    }
+}
+
+static void TestIpProfileFile() {
+    IpProfile profile;
+    profile.images.push_back("/lib/libOPENFHEpke.so");
+    profile.images.push_back("");
+    for (uint64_t i = 0; i < 100; i++) {
+        profile.records.push_back({i * 4, i + 1, static_cast<uint32_t>(i % 2), 5, IP_DEST_REG});
+    }
+    std::string path = TempPath("ipprof");
+    CHECK(WriteIpProfile(path, profile));
+
+    IpProfile read;
+    CHECK(ReadIpProfile(path, read));
+    CHECK(read.images == profile.images);
+    CHECK(read.records.size() == profile.records.size());
+    CHECK(std::memcmp(read.records.data(), profile.records.data(),
+                      profile.records.size() * sizeof(IpProfileRecord)) == 0);
+
+    // Cantidad de registros dañada: se rechaza sin reservar memoria para ella
+    std::string data = ReadFile(path);
+    uint64_t numRecords = UINT64_MAX / sizeof(IpProfileRecord);
+    std::memcpy(&data[sizeof(IP_PROFILE_MAGIC) + 2 * sizeof(uint32_t)],
+                &numRecords, sizeof(numRecords));
+    WriteFile(path, data);
+    CHECK(!ReadIpProfile(path, read));
+    CHECK(read.records.empty());
+
+    WriteFile(path, ReadFile(path).substr(0, 20));
+    CHECK(!ReadIpProfile(path, read));
+
+    std::remove(path.c_str());
+}
+
+// ============================================================================
+// CACHE DE DECISIONES (-decision_cache)
+// ============================================================================
+
+static const uint64_t kOptionsHash = 0x1234;
+static const uint32_t kNumArithTypes = 30;
+
+static std::string WriteSampleCache(const std::string& path) {
+    DecisionCacheBuilder builder;
+    builder.BeginRoutine(0x1000, "lbcrypto::EvalMult");
+    builder.AddSite(0x1004, 2);
+    builder.AddSite(0x1010, 12);
+    builder.EndRoutine();
+    builder.BeginRoutine(0x2000, "sin_sitios");
+    builder.EndRoutine();
+    builder.BeginRoutine(0x3000, "lbcrypto::EvalAdd");
+    builder.AddSite(0x3008, 0);
+    builder.EndRoutine();
+    CHECK(builder.Write(path, kOptionsHash));
+    return ReadFile(path);
+}
+
+static void TestDecisionCache() {
+    std::string path = TempPath("dcache");
+    std::string good = WriteSampleCache(path);
+
+    DecisionCacheView view;
+    CHECK(view.Open(path, kOptionsHash, kNumArithTypes));
+    CHECK(view.NumRoutines() == 2);
+    if (view.NumRoutines() == 2) {
+        const DecisionRoutine& r = view.Routine(1);
+        CHECK(r.offset == 0x3000);
+        CHECK(std::string(view.Name(r)) == "lbcrypto::EvalAdd");
+        CHECK(r.numSites == 1 && view.Sites(r)[0].offset == 0x3008);
+        CHECK(view.Routine(0).numSites == 2 && view.Sites(view.Routine(0))[1].arithType == 12);
+    }
+    CHECK(!view.Open(path, kOptionsHash + 1, kNumArithTypes));
+    CHECK(!view.Open(TempPath("no_existe"), kOptionsHash, kNumArithTypes));
+    CHECK(ReadElfBuildId(path).empty());
+    CHECK(HashOptions("a") != HashOptions("b"));
+}
+
+// Escribir un campo en una copia del cache; true si Open la rechaza
+template <typename T>
+static bool RejectsCorruptCache(const std::string& good, size_t offset, T value) {
+    std::string data = good;
+    std::memcpy(&data[offset], &value, sizeof(value));
+    std::string path = TempPath("dcache.bad");
+    WriteFile(path, data);
+    DecisionCacheView view;
+    bool rejected = !view.Open(path, kOptionsHash, kNumArithTypes);
+    std::remove(path.c_str());
+    return rejected;
+}
+
+// Índices fuera de sus tablas descartan el cache: el injector vuelve al
+// recorrido completo en vez de leer fuera del archivo mapeado
+static void TestCorruptDecisionCache() {
+    std::string path = TempPath("dcache");
+    std::string good = WriteSampleCache(path);
+    std::remove(path.c_str());
+
+    const size_t header = 0;
+    const size_t routine0 = sizeof(DecisionCacheHeader);
+    const size_t routine1 = routine0 + sizeof(DecisionRoutine);
+    const size_t site1 = routine0 + 2 * sizeof(DecisionRoutine) + sizeof(DecisionSite);
+
+    CHECK(RejectsCorruptCache(good, routine1 + offsetof(DecisionRoutine, firstSite), uint32_t(3)));
+    CHECK(RejectsCorruptCache(good, routine1 + offsetof(DecisionRoutine, numSites), uint32_t(0xFFFFFFFF)));
+    CHECK(RejectsCorruptCache(good, routine0 + offsetof(DecisionRoutine, firstSite), uint32_t(0xFFFFFFFF)));
+    CHECK(RejectsCorruptCache(good, routine0 + offsetof(DecisionRoutine, name), uint32_t(1000)));
+    CHECK(RejectsCorruptCache(good, site1 + offsetof(DecisionSite, arithType), kNumArithTypes));
+    CHECK(RejectsCorruptCache(good, site1 + offsetof(DecisionSite, offset), uint64_t(0x1000)));
+    CHECK(RejectsCorruptCache(good, header + offsetof(DecisionCacheHeader, numSites), UINT64_MAX / 8));
+    CHECK(RejectsCorruptCache(good, header + offsetof(DecisionCacheHeader, numRoutines), uint32_t(3)));
+    CHECK(RejectsCorruptCache(good, header + offsetof(DecisionCacheHeader, version), uint32_t(99)));
+
+    std::string truncated = TempPath("dcache.short");
+    WriteFile(truncated, good.substr(0, good.size() - 1));
+    DecisionCacheView view;
+    CHECK(!view.Open(truncated, kOptionsHash, kNumArithTypes));
+    std::remove(truncated.c_str());
+}
+
+int main() {
+    TestSubstringFilter();
+    TestDemangledNames();
+    TestRegexFilter();
+    TestExcludeFilter();
+    TestProfileRoundTrip();
+    TestCorruptProfile();
+    TestAliasProportions();
+    TestSampleSite();
+    TestIpProfileFile();
+    TestDecisionCache();
+    TestCorruptDecisionCache();
+
+    if (failures > 0) {
+        std::cerr << failures << " chequeos fallidos" << std::endl;
+        return 1;
+    }
+    std::cout << "✓ test_common: todos los chequeos pasaron" << std::endl;
+    return 0;
+}